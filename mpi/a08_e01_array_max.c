@@ -1,19 +1,22 @@
 /**
  * Finds the maximum value from an array of integers.
  * Rank 0 is responsible for initializing the array.
+ * See a08_e02_array_max_stream.c for arrays that don't fit on one rank.
  *
  * Compile and run:
- * mpicc -o a08_e01_array_max a08_e01_array_max.c
+ * mpicc -fopenmp -o a08_e01_array_max a08_e01_array_max.c
  * mpiexec -n 4 ./a08_e01_array_max
  */
 
 #include <assert.h>
-#include <limits.h>   /* INT_MIN */
 #include <mpi.h>
 #include <stdio.h>    /* printf */
 #include <stdlib.h>   /* malloc, free */
 #include <time.h>
 
+#include "../openmp/reduce.h"
+#include "partition.h"
+
 /**
  * Calculates the maximum value from an array.
  * @param  ary  The array.
@@ -21,11 +24,7 @@
  * @return      The maximum value.
  */
 int array_max(int* ary, int size) {
-  int max = INT_MIN;
-  for (int i = 0; i < size; ++i) {
-    if (ary[i] > max) max = ary[i];
-  }
-  return max;
+  return reduce_max_i(ary, size);
 }
 
 /**
@@ -41,38 +40,6 @@ int* init_array(int ary_size) {
   return ary;
 }
 
-/**
- * Calculates the necessary parameters for MPI_Scatterv.
- * @param  ary_size      Size of the entire array of data
- * @param  world_size    Number of processes
- * @param  sendcounts    Array for the number of elements for each process.
- * @param  displacements Array for the displacement index for each process.
- */
-void calculate_for_scatterv(int ary_size, int world_size, int* sendcounts,
-                           int* displacements) {
-
-  // "Default" number of elements each process will receive.
-  int elements_per_process = ary_size / world_size;
-
-  // How many elements will have to be redistributed.
-  int remainder = ary_size % world_size;
-
-  int i, count, displacement = 0;
-
-  for (i = 0; i < world_size; ++i) {
-    if (i < world_size - remainder) {
-      count = elements_per_process;
-    }
-    else {
-      count = elements_per_process + 1;
-    }
-
-    sendcounts[i] = count;
-    displacements[i] = displacement;
-    displacement += count;
-  }
-}
-
 int main(int argc, char** argv) {
 
   // Initialize MPI.
@@ -90,19 +57,19 @@ int main(int argc, char** argv) {
 
   printf("[%d] Hello!\n", my_rank);
 
-   // Array specifying the length of each split.
-  int* sendcounts = (int*)malloc(sizeof(int) * world_size);
+  // Array specifying the length of each split.
+  long* sendcounts = (long*)malloc(sizeof(long) * world_size);
   assert(sendcounts != NULL);
 
   // Array specifying the index at which each split begins.
-  int* displacements = (int*)malloc(sizeof(int) * world_size);
+  long* displacements = (long*)malloc(sizeof(long) * world_size);
   assert(displacements != NULL);
 
   // Split the array into (world_size) groups.
-  calculate_for_scatterv(ARRAY_SIZE, world_size, sendcounts, displacements);
+  partition_block_counts(ARRAY_SIZE, world_size, sendcounts, displacements);
 
   int i;
-  int* array;
+  int* array = NULL;
 
   if(my_rank == 0) {
 
@@ -111,9 +78,9 @@ int main(int argc, char** argv) {
 
     printf("Calculated displacements:\n");
     printf("sendcounts:    ");
-    for (i = 0; i < world_size; ++i) printf("    %d", sendcounts[i]);
+    for (i = 0; i < world_size; ++i) printf("    %ld", sendcounts[i]);
     printf("\ndisplacements: ");
-    for (i = 0; i < world_size; ++i) printf("    %d", displacements[i]);
+    for (i = 0; i < world_size; ++i) printf("    %ld", displacements[i]);
     printf("\n");
   }
 
@@ -121,8 +88,8 @@ int main(int argc, char** argv) {
   int* splitbuf = (int*)malloc(sizeof(int) * ((ARRAY_SIZE / world_size) + 1));
 
   // Receive data.
-  MPI_Scatterv(array, sendcounts, displacements, MPI_INT, splitbuf,
-               (ARRAY_SIZE / world_size) + 1, MPI_INT, 0, MPI_COMM_WORLD);
+  partition_scatterv(array, sendcounts, displacements, MPI_INT, splitbuf, 0,
+                     MPI_COMM_WORLD);
 
   // Each process prints what they received from root.
   printf("[%d] ", my_rank);
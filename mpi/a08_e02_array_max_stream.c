@@ -0,0 +1,182 @@
+/**
+ * Finds the maximum value of a very large array, and where it is, without
+ * ever having the whole array in one place.
+ *
+ * a08_e01_array_max.c has rank 0 build the whole array and MPI_Scatterv it,
+ * so root needs memory and time for all of it. Here every rank only produces
+ * its own block of the array, in chunks of CHUNK elements, so the memory per
+ * rank stays constant however large n is. The values come either from:
+ *
+ * - the counter-based generator of openmp/parallel_rng.h, indexed by global
+ *   position, so the array (and the answer) is the same for any number of
+ *   ranks and threads; or
+ * - a binary file of doubles (file=PATH), which every rank reads its block of
+ *   with MPI-IO. n defaults to the size of the file.
+ *
+ * The max of every chunk, and its index, is found with reduce_argmax_d() of
+ * openmp/reduce.h (vectorized, with OpenMP threads inside the rank). The
+ * ranks then join in one MPI_Allreduce, so every rank gets the value and the
+ * global index:
+ *
+ * - by default with reduce_mpi.h's user-defined op on (double, long) pairs;
+ * - with "maxloc", with the built-in MPI_MAXLOC. Its MPI_DOUBLE_INT pairs
+ *   only have an int for the location, which can't hold an index above 2^31,
+ *   so the location is the rank; the winning rank then broadcasts the index.
+ *
+ * Compile & run:
+ * $ mpicc -O2 -fopenmp -o a08_e02_array_max_stream a08_e02_array_max_stream.c
+ * $ OMP_NUM_THREADS=4 mpiexec -n 4 ./a08_e02_array_max_stream 10000000000
+ * $ mpiexec -n 4 ./a08_e02_array_max_stream 0 maxloc file=data.bin
+ */
+
+#include <assert.h>
+#include <math.h>     /* INFINITY */
+#include <mpi.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atol */
+#include <string.h>   /* strcmp, strncmp */
+
+#include "../openmp/parallel_rng.h"
+#include "partition.h"
+#include "reduce_mpi.h"
+
+#define N     1000000000L
+#define CHUNK (1L << 22)   // Elements generated or read at a time.
+#define SEED  12345
+
+/**
+ * Fills buf with elements [first, first + len) of the generated array.
+ */
+void generate_chunk(double* buf, long first, long len) {
+  long i;
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < len; ++i) {
+    buf[i] = rng_uniform(SEED, (uint64_t)(first + i));
+  }
+}
+
+/**
+ * Max of elements [begin, end) of the array, with its global index.
+ */
+reduce_loc_d_t local_argmax(long begin, long end, MPI_File file) {
+  reduce_loc_d_t best = { -INFINITY, -1 };
+  double* buf = (double*)malloc(sizeof(double) * CHUNK);
+  assert(buf != NULL);
+
+  for (long first = begin; first < end; first += CHUNK) {
+    long len = (end - first < CHUNK) ? end - first : CHUNK;
+
+    if (file != MPI_FILE_NULL) {
+      MPI_File_read_at(file, (MPI_Offset)first * sizeof(double), buf,
+                       (int)len, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    }
+    else {
+      generate_chunk(buf, first, len);
+    }
+
+    reduce_loc_d_t chunk = reduce_argmax_d(buf, len);
+    if (chunk.index >= 0) chunk.index += first;
+    best = reduce_loc_d_max(best, chunk);
+  }
+
+  free(buf);
+  return best;
+}
+
+/**
+ * Global max with MPI_MAXLOC on (value, rank), then the index from the rank
+ * that has it. Ties go to the lowest rank, which has the lowest index.
+ */
+reduce_loc_d_t allreduce_maxloc(reduce_loc_d_t local, int my_rank,
+                                MPI_Comm comm) {
+  struct { double value; int rank; } in = { local.value, my_rank }, out;
+  reduce_loc_d_t global;
+
+  MPI_Allreduce(&in, &out, 1, MPI_DOUBLE_INT, MPI_MAXLOC, comm);
+
+  global.value = out.value;
+  global.index = local.index;
+  MPI_Bcast(&global.index, 1, MPI_LONG, out.rank, comm);
+  return global;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+
+  // Only the main thread of each rank calls MPI.
+  int provided;
+  MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+
+  int world_size, my_rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+  long n = N;
+  int maxloc = 0;
+  const char* path = NULL;
+  MPI_File file = MPI_FILE_NULL;
+
+  if (argc > 1) n = atol(argv[1]);
+  for (int a = 2; a < argc; ++a) {
+    if (strcmp(argv[a], "maxloc") == 0) maxloc = 1;
+    else if (strncmp(argv[a], "file=", 5) == 0) path = argv[a] + 5;
+  }
+
+  if (path != NULL) {
+    MPI_Offset size;
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS) {
+      if (my_rank == 0) fprintf(stderr, "Can't open %s\n", path);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_get_size(file, &size);
+    if (n <= 0 || n > (long)(size / sizeof(double))) {
+      n = (long)(size / sizeof(double));
+    }
+  }
+
+  if (n <= 0) {
+    if (my_rank == 0) {
+      fprintf(stderr, "Usage: %s [n] [maxloc] [file=PATH]\n", argv[0]);
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  reduce_mpi_init();
+
+  long begin, end;
+  partition_block(n, world_size, my_rank, &begin, &end);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double elapsed = -MPI_Wtime();
+
+  reduce_loc_d_t local = local_argmax(begin, end, file);
+
+  double comm_time = -MPI_Wtime();
+  reduce_loc_d_t global = maxloc
+    ? allreduce_maxloc(local, my_rank, MPI_COMM_WORLD)
+    : reduce_mpi_argmax_d(local, MPI_COMM_WORLD);
+  comm_time += MPI_Wtime();
+
+  elapsed += MPI_Wtime();
+
+  double max_elapsed;
+  MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  if (my_rank == 0) {
+    printf("n = %ld, ranks = %d, threads per rank = %d, reduction = %s\n", n,
+           world_size, omp_get_max_threads(), maxloc ? "MPI_MAXLOC" : "argmax");
+    printf("Global max: %.17g at index %ld\n", global.value, global.index);
+    printf("Done in %lfs (%.2f G elements/s), allreduce on rank 0: %.6fs\n",
+           max_elapsed, n / max_elapsed * 1e-9, comm_time);
+  }
+
+  if (file != MPI_FILE_NULL) MPI_File_close(&file);
+  reduce_mpi_free();
+  MPI_Finalize();
+  return 0;
+}
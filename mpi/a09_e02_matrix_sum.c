@@ -23,6 +23,8 @@
  * # On a different terminal:
  * mpiexec --output-filename matrix_sum_out -n 4 ./a09_e02_matrix_sum
  *
+ * See a09_e03_matrix_sum_n.c for any number of producers, received in the
+ * order they finish, or summed with MPI_Reduce / MPI_Ireduce.
  */
 
 #include <assert.h>
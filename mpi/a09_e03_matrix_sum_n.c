@@ -0,0 +1,320 @@
+/**
+ * Sum of the matrices of any number of producer processes.
+ *
+ * a09_e02_matrix_sum.c needs exactly 4 processes: three producers with their
+ * own copy of the code, and a master that receives row i from rank 1, then
+ * from rank 2, then from rank 3, with blocking receives, so a slow producer
+ * holds back the rows that the others already sent. Here ranks 1 .. p are all
+ * producers running the same code, and rank 0 sums their matrices. Each
+ * producer computes its matrix in blocks of `block_rows` rows, and every block
+ * is added to the sum as soon as it is ready, in one of three ways:
+ *
+ * - funnel (default): producers MPI_Isend each block to root. Root keeps
+ *   2 * p receives posted with MPI_ANY_SOURCE and MPI_ANY_TAG (the tag is the
+ *   block) and adds blocks into the sum in whatever order they complete
+ *   (MPI_Waitany), reposting each buffer right away.
+ * - reduce: one MPI_Reduce(MPI_SUM) per block, so the sums are done by MPI,
+ *   along a tree instead of all on root.
+ * - ireduce: the same with MPI_Ireduce, so producers go on with the next
+ *   block while the previous ones are being reduced.
+ *
+ * The matrices come from the counter-based generator in
+ * openmp/parallel_rng.h, so root can check SAMPLES entries of the sum on its
+ * own. The matrices are printed when they have at most PRINT_MAX_N rows and
+ * columns.
+ *
+ * Compile & run:
+ * $ mpicc -O2 -fopenmp -o a09_e03_matrix_sum_n a09_e03_matrix_sum_n.c
+ * $ mpiexec -n 5 ./a09_e03_matrix_sum_n 4 4
+ * $ mpiexec -n 9 ./a09_e03_matrix_sum_n 4096 4096 ireduce 64
+ */
+
+#include <assert.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atoi */
+#include <string.h>   /* memset, strcmp */
+
+#include "../openmp/parallel_rng.h"
+
+#define ROWS        1024
+#define COLS        1024
+#define BLOCK_ROWS  16
+#define PRINT_MAX_N 8
+#define SAMPLES     64
+#define SEED        12345
+#define MAX_VALUE   100
+#define MAX_BLOCKS  32767  // Blocks are tags, and tags may stop at 32767.
+
+enum { FUNNEL, REDUCE, IREDUCE };
+
+const char* mode_names[] = { "funnel", "reduce", "ireduce" };
+
+// Prototypes.
+void print_matrix(void* m, int rows, int cols);
+
+/**
+ * Element (i, j) of the matrix of producer `rank`.
+ */
+static inline int element(int rank, int cols, long i, long j) {
+  return rng_bounded(rng_u64(SEED + rank, (uint64_t)(i * cols + j)),
+                     MAX_VALUE);
+}
+
+/**
+ * Computes rows [first, first + rows) of the matrix of producer `rank`.
+ */
+void produce_block(int* m, int rank, int cols, int first, int rows) {
+  for (long i = first; i < first + rows; ++i) {
+    for (long j = 0; j < cols; ++j) {
+      m[i * cols + j] = element(rank, cols, i, j);
+    }
+  }
+}
+
+/**
+ * Producer: computes its matrix block by block and hands every block over
+ * to root as soon as it is done.
+ */
+void producer(int my_rank, int mode, int rows, int cols, int block_rows) {
+  int nblocks = (rows + block_rows - 1) / block_rows;
+  int* m = (int*)malloc(sizeof(int) * rows * cols);
+  MPI_Request* requests = (MPI_Request*)malloc(sizeof(MPI_Request) * nblocks);
+  assert(m != NULL && requests != NULL);
+
+  for (int b = 0; b < nblocks; ++b) {
+    int first = b * block_rows;
+    int count = ((rows - first < block_rows) ? rows - first : block_rows)
+                * cols;
+    int* block = &m[(long)first * cols];
+
+    produce_block(m, my_rank, cols, first, count / cols);
+
+    switch (mode) {
+      case FUNNEL:
+        MPI_Isend(block, count, MPI_INT, 0, b, MPI_COMM_WORLD, &requests[b]);
+        break;
+      case REDUCE:
+        MPI_Reduce(block, NULL, count, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+        requests[b] = MPI_REQUEST_NULL;
+        break;
+      case IREDUCE:
+        MPI_Ireduce(block, NULL, count, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD,
+                    &requests[b]);
+        break;
+    }
+  }
+
+  MPI_Waitall(nblocks, requests, MPI_STATUSES_IGNORE);
+
+  if (rows <= PRINT_MAX_N && cols <= PRINT_MAX_N) {
+    printf("[%d] My matrix:\n", my_rank);
+    print_matrix(m, rows, cols);
+  }
+
+  free(m);
+  free(requests);
+}
+
+/**
+ * Root, funnel mode: adds the blocks of every producer into `sum`, in the
+ * order they arrive.
+ */
+void root_funnel(int* sum, int nproducers, int rows, int cols,
+                 int block_rows) {
+  int nblocks = (rows + block_rows - 1) / block_rows;
+  long remaining = (long)nblocks * nproducers;  // Blocks not received yet.
+  long posted = 0;
+  int nbuffers = 2 * nproducers;
+  int* buffers = (int*)malloc(sizeof(int) * nbuffers * block_rows * cols);
+  MPI_Request* requests =
+    (MPI_Request*)malloc(sizeof(MPI_Request) * nbuffers);
+  assert(buffers != NULL && requests != NULL);
+
+  for (int k = 0; k < nbuffers; ++k) {
+    requests[k] = MPI_REQUEST_NULL;
+    if (posted < remaining) {
+      MPI_Irecv(&buffers[k * block_rows * cols], block_rows * cols, MPI_INT,
+                MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &requests[k]);
+      ++posted;
+    }
+  }
+
+  while (remaining > 0) {
+    int k, count;
+    MPI_Status status;
+
+    MPI_Waitany(nbuffers, requests, &k, &status);
+    MPI_Get_count(&status, MPI_INT, &count);
+
+    // The tag says which block it is.
+    const int* buf = &buffers[k * block_rows * cols];
+    int* dst = &sum[(long)status.MPI_TAG * block_rows * cols];
+    for (int e = 0; e < count; ++e) dst[e] += buf[e];
+    --remaining;
+
+    // Reuse the buffer for whatever arrives next.
+    if (posted < (long)nblocks * nproducers) {
+      MPI_Irecv(&buffers[k * block_rows * cols], block_rows * cols, MPI_INT,
+                MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &requests[k]);
+      ++posted;
+    }
+  }
+
+  free(buffers);
+  free(requests);
+}
+
+/**
+ * Root, reduce and ireduce modes: takes part in the reduction of every
+ * block, with its own contribution (zeros) already in `sum`.
+ */
+void root_reduce(int* sum, int mode, int rows, int cols, int block_rows) {
+  int nblocks = (rows + block_rows - 1) / block_rows;
+  MPI_Request* requests = (MPI_Request*)malloc(sizeof(MPI_Request) * nblocks);
+  assert(requests != NULL);
+
+  for (int b = 0; b < nblocks; ++b) {
+    int first = b * block_rows;
+    int count = ((rows - first < block_rows) ? rows - first : block_rows)
+                * cols;
+    int* block = &sum[(long)first * cols];
+
+    if (mode == REDUCE) {
+      MPI_Reduce(MPI_IN_PLACE, block, count, MPI_INT, MPI_SUM, 0,
+                 MPI_COMM_WORLD);
+      requests[b] = MPI_REQUEST_NULL;
+    }
+    else {
+      MPI_Ireduce(MPI_IN_PLACE, block, count, MPI_INT, MPI_SUM, 0,
+                  MPI_COMM_WORLD, &requests[b]);
+    }
+  }
+
+  MPI_Waitall(nblocks, requests, MPI_STATUSES_IGNORE);
+  free(requests);
+}
+
+/**
+ * Checks SAMPLES random entries of the sum.
+ */
+int check(const int* sum, int nproducers, int rows, int cols) {
+  for (int s = 0; s < SAMPLES; ++s) {
+    long i = rng_bounded(rng_u64(SEED - 1, 2 * s), rows);
+    long j = rng_bounded(rng_u64(SEED - 1, 2 * s + 1), cols);
+    int expected = 0;
+    for (int p = 1; p <= nproducers; ++p) {
+      expected += element(p, cols, i, j);
+    }
+    if (sum[i * cols + j] != expected) return 0;
+  }
+  return 1;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+
+  // Initialize MPI.
+  MPI_Init(NULL, NULL);
+
+  int world_size, my_rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+  int rows = ROWS, cols = COLS, block_rows = BLOCK_ROWS, mode = FUNNEL;
+  if (argc > 1) rows = atoi(argv[1]);
+  if (argc > 2) cols = atoi(argv[2]);
+  if (argc > 3) {
+    mode = -1;
+    for (int m = FUNNEL; m <= IREDUCE; ++m) {
+      if (strcmp(argv[3], mode_names[m]) == 0) mode = m;
+    }
+  }
+  if (argc > 4) block_rows = atoi(argv[4]);
+
+  if (world_size < 2 || rows < 1 || cols < 1 || block_rows < 1 ||
+      mode < 0) {
+    if (my_rank == 0) {
+      fprintf(stderr, "Usage: %s [rows] [cols] [funnel|reduce|ireduce] "
+              "[block_rows], with at least 2 processes\n", argv[0]);
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  if (block_rows > rows) block_rows = rows;
+  if ((rows + block_rows - 1) / block_rows > MAX_BLOCKS) {
+    block_rows = (rows + MAX_BLOCKS - 1) / MAX_BLOCKS;
+  }
+
+  int nproducers = world_size - 1;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double elapsed = -MPI_Wtime();
+
+  if (my_rank == 0) {
+    int* sum = (int*)malloc(sizeof(int) * rows * cols);
+    assert(sum != NULL);
+    memset(sum, 0, sizeof(int) * rows * cols);
+
+    if (mode == FUNNEL) root_funnel(sum, nproducers, rows, cols, block_rows);
+    else root_reduce(sum, mode, rows, cols, block_rows);
+
+    elapsed += MPI_Wtime();
+
+    if (rows <= PRINT_MAX_N && cols <= PRINT_MAX_N) {
+      printf("[%d] Sum:\n", my_rank);
+      print_matrix(sum, rows, cols);
+    }
+
+    // Throughput: elements of the producers' matrices added per second.
+    double elements = (double)nproducers * rows * cols;
+    printf("[%d] %d producers, %d x %d, %s, blocks of %d rows: %.4fs, "
+           "%.1f M elements/s. Check: %s\n", my_rank, nproducers, rows, cols,
+           mode_names[mode], block_rows, elapsed, elements / elapsed * 1e-6,
+           check(sum, nproducers, rows, cols) ? "ok" : "WRONG");
+
+    free(sum);
+  }
+  else {
+    producer(my_rank, mode, rows, cols, block_rows);
+  }
+
+  // Clean up.
+  MPI_Finalize();
+  return 0;
+}
+
+/**
+ * Pretty-prints a matrix.
+ * @param m    The matrix
+ * @param rows Number of rows
+ * @param cols Number of columns
+ */
+void print_matrix(void* m, int rows, int cols) {
+  // `matrix` is a pointer to an array of cols integers.
+  int (*matrix)[cols] = m;
+
+  // Print row of column indexes.
+  for (int i = 0; i < cols; ++i) {
+    if (i == 0) { printf("      "); }
+    printf("%4d ", i);
+  }
+  printf("\n");
+
+  // Print row of dashes ('-').
+  for (int i = 0; i < cols; ++i) {
+    if (i == 0) { printf("     "); }
+    printf("-----");
+  }
+  printf("\n");
+
+  // Print matrix.
+  for(int i = 0; i < rows; ++i) {
+    printf("%4d |", i);
+    for (int j = 0; j < cols; ++j) {
+      printf("%4d ", *(*(matrix + i) + j));
+    }
+    printf("\n");
+  }
+}
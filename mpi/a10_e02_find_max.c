@@ -1,19 +1,25 @@
 /**
  * Finds the max value in a matrix of size ROWS x COLS, initialized with
- * random values, using a distributed search, per row, implemented with
- * MPI_Scatter and MPI_Reduce.
+ * random values, using a distributed search, per row, implemented with a
+ * scatter and a reduction. The rows are split as evenly as possible with
+ * partition.h, so any number of processes works. Every process finds the max
+ * of its rows (and where it is) with reduce.h, and the (value, index) pairs
+ * are combined with the user-defined MPI_Op of reduce_mpi.h, so everybody
+ * also learns the position of the max in the whole matrix.
  *
  * Compile & run:
- * $ mpicc -o a10_e02_find_max a10_e02_find_max.c
- * $ mpiexec -n 5 ./a10_e02_find_max
+ * $ mpicc -fopenmp -o a10_e02_find_max a10_e02_find_max.c
+ * $ mpiexec -n 4 ./a10_e02_find_max
  */
 
-#include <limits.h>   /* INT_MIN */
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#include "partition.h"
+#include "reduce_mpi.h"
+
 // Matrix dimensions.
 const int ROWS = 10;
 const int COLS = 15;
@@ -34,23 +40,23 @@ int main(int argc, char** argv) {
   MPI_Comm_size(MPI_COMM_WORLD, &world_size);
   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 
-  // Since we don't want to use MPI_Scatterv, the number of rows must be
-  // divisible by the number of processes.
-  if (ROWS % world_size != 0) {
-    fprintf(stderr,
-            "Use a number of processes that is multiple of %d (used: %d)\n",
-            ROWS, world_size);
-    MPI_Abort(MPI_COMM_WORLD, 1);
-  }
-
   // Seed random number generator.
   srand(time(NULL));
 
-  // How many rows from the original matrix each process will receive.
-  int rows_per_process = ROWS / world_size;
+  // How many rows from the original matrix each process will receive, and
+  // the first of them.
+  long* row_counts = malloc(sizeof(long) * world_size);
+  long* row_displs = malloc(sizeof(long) * world_size);
+  partition_block_counts(ROWS, world_size, row_counts, row_displs);
+  int rows_per_process = (int)row_counts[my_rank];
+
+  // One row of the matrix, so the counts above are in rows.
+  MPI_Datatype row_type;
+  MPI_Type_contiguous(COLS, MPI_INT, &row_type);
+  MPI_Type_commit(&row_type);
 
-  int (*matrix)[COLS];     // The whole matrix.
-  int (*submatrix)[COLS];  // The submatrix, per process.
+  int (*matrix)[COLS] = NULL;  // The whole matrix.
+  int (*submatrix)[COLS];      // The submatrix, per process.
   submatrix = malloc(sizeof(int) * rows_per_process * COLS);
 
   // Initialize matrix.
@@ -67,8 +73,8 @@ int main(int argc, char** argv) {
   }
 
   // Assign a group of rows to each rank.
-  MPI_Scatter(matrix, rows_per_process * COLS, MPI_INT, submatrix,
-              rows_per_process * COLS, MPI_INT, 0, MPI_COMM_WORLD);
+  partition_scatterv(matrix, row_counts, row_displs, row_type, submatrix, 0,
+                     MPI_COMM_WORLD);
 
   printf("[%d] My rows:\n", my_rank);
   int i;
@@ -77,27 +83,28 @@ int main(int argc, char** argv) {
     print_array(submatrix[i], COLS);
   }
 
-  // All processes: find their maximum.
-  int max = INT_MIN, j;
-  for (i = 0; i < rows_per_process; ++i) {
-    for (j = 0; j < COLS; ++j) {
-      if (submatrix[i][j] > max) {
-        max = submatrix[i][j];
-      }
-    }
-  }
+  // All processes: find their maximum, and its index in the whole matrix.
+  reduce_loc_i_t max = reduce_argmax_i(&submatrix[0][0],
+                                       (long)rows_per_process * COLS);
+  if (max.index >= 0) max.index += row_displs[my_rank] * COLS;
 
-  printf("[%d] My max: %d\n", my_rank, max);
+  printf("[%d] My max: %d\n", my_rank, max.value);
 
-  int global_max;
-  MPI_Reduce(&max, &global_max, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+  reduce_mpi_init();
+  reduce_loc_i_t global_max = reduce_mpi_argmax_i(max, MPI_COMM_WORLD);
 
   if (my_rank == 0) {
-    printf("Done! Global max is: %d\n", global_max);
+    printf("Done! Global max is: %d, at row %ld, column %ld\n",
+           global_max.value, global_max.index / COLS, global_max.index % COLS);
     free(matrix);
   }
 
   // Clean up.
+  free(submatrix);
+  free(row_counts);
+  free(row_displs);
+  MPI_Type_free(&row_type);
+  reduce_mpi_free();
   MPI_Finalize();
   return 0;
 }
@@ -5,19 +5,35 @@
  *   - Z = E * F
  *   - Each of these is a square matrix of floats.
  *
- * Task 1: initialize A and B and sends each calculated row of X to root using
- *        MPI_Isend and MPI_Wait.
- * Task 2: initialize C and D and sends each calculated row of Y to root using
- *        MPI_Isend and MPI_Wait.
- * Task 3: initialize E and F and sends each calculated row of Z to root using
- *        MPI_Isend and MPI_Wait.
- * Task 4: initialize T and receives lines of X, Y and Z from other ranks using
- *        MPI_Irecv and MPI_Wait to calculate W.
+ * Task 1: initialize A and B and sends each calculated row of X to root with
+ *        MPI_Isend.
+ * Task 2: initialize C and D and sends each calculated row of Y to root with
+ *        MPI_Isend.
+ * Task 3: initialize E and F and sends each calculated row of Z to root with
+ *        MPI_Isend.
+ * Task 4: initialize T and receives rows of X, Y and Z from other ranks with
+ *        MPI_Irecv to calculate W.
+ *
+ * The matrices are N x N, with N given on the command line (default 2), and
+ * the products are computed with the blocked kernel of openmp/gemm.h. They
+ * are only printed when N <= PRINT_MAX_N.
+ *
+ * By default (or with "sync") the rows travel synchronously: tasks 1-3
+ * compute their whole product, post one MPI_Isend per row and finish with
+ * MPI_Waitall, and task 4 posts the receives of one row and waits for them
+ * (MPI_Waitall) before computing it. With "pipeline", tasks 1-3 send each
+ * block of rows as soon as it is computed, with at most `window` sends in
+ * flight (a request slot is waited for before reuse, MPI_Testsome releases
+ * completed sends after every block, and MPI_Waitall drains the rest), and
+ * task 4 keeps the receives of `window` rows posted (default WINDOW),
+ * reposting a row's buffers as soon as it has been summed, so receiving,
+ * computing W and computing X overlap. "compare" runs both, on the same
+ * matrices, and reports the time saved.
  *
  * Recommended way of running locally, to see each process output in its own
  * terminal:
  * # Compile
- * mpicc -o a10_e03_matrix_multiplication a10_e03_matrix_multiplication.c
+ * mpicc -O2 -fopenmp -o a10_e03_matrix_multiplication a10_e03_matrix_multiplication.c
  * # Setup
  * touch a10_e03.1.0 a10_e03.1.1 a10_e03.1.2 a10_e03.1.3
  *
@@ -29,124 +45,269 @@
  *
  * # On a different terminal:
  * mpiexec --output-filename matrix_sum_out -n 4 ./a10_e03_matrix_multiplication
+ *
+ * Larger matrices:
+ * mpiexec -n 4 ./a10_e03_matrix_multiplication 2048
+ * mpiexec -n 4 ./a10_e03_matrix_multiplication 2048 compare 16
+ *
+ * See a10_e04_summa.c for one product spread over a 2D grid of any square
+ * number of processes, and transfer.h for rows and column blocks sent again
+ * and again with persistent requests.
  */
 
+#include <assert.h>
 #include <mpi.h>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>   /* memset, strcmp */
+
+#include "../openmp/gemm.h"
 
-// Matrix dimensions.
-const int N = 2;
+// Matrices larger than this are not printed.
+#define PRINT_MAX_N 8
+
+// Rows in flight per sender and per matrix on root, in pipelined mode.
+#define WINDOW 8
+
+#define SEED 12345
+
+// Matrix dimensions (N x N). Set from the command line.
+int N = 2;
 
 // Prototypes.
 void print_matrix(void* m, int rows, int cols);
 void print_array(float* array, int size);
 
 /**
- * [task description]
+ * Computes X = A * B for random A and B, and sends every row of X to root.
+ *
+ * Synchronous: computes the whole product, then posts one MPI_Isend per row
+ * (N requests) and waits for all of them.
+ *
+ * Pipelined: computes X in blocks of rows and sends each block as soon as it
+ * is done, so root can start on the first rows while the rest are computed.
+ * At most `window` sends are in flight: before reusing a request slot, its
+ * previous send is waited for, and MPI_Testsome after every block releases
+ * the sends that already completed (and lets MPI progress them).
  */
-void task_ABX(int my_rank) {
-  float mA[N][N];
-  float mB[N][N];
-  float mX[N][N];
-  int i, j, k;
-  MPI_Request requests[N];
-
-  for (int i = 0; i < N; ++i) {
-    for (int j = 0; j < N; ++j) {
-      mA[i][j] = (rand() / (float)RAND_MAX) * 100;
-      mB[i][j] = (rand() / (float)RAND_MAX) * 100;
-    }
+void task_ABX(int my_rank, int pipeline, int window) {
+  float* mA = (float*)malloc(sizeof(float) * N * N);
+  float* mB = (float*)malloc(sizeof(float) * N * N);
+  float* mX = (float*)malloc(sizeof(float) * N * N);
+  int nrequests = pipeline ? window : N;
+  MPI_Request* requests = (MPI_Request*)malloc(sizeof(MPI_Request) * nrequests);
+  int* indices = (int*)malloc(sizeof(int) * nrequests);
+  int i;
+  assert(mA != NULL && mB != NULL && mX != NULL && requests != NULL &&
+         indices != NULL);
+
+  for (i = 0; i < N * N; ++i) {
+    mA[i] = (rand() / (float)RAND_MAX) * 100;
+    mB[i] = (rand() / (float)RAND_MAX) * 100;
   }
+  for (i = 0; i < nrequests; ++i) requests[i] = MPI_REQUEST_NULL;
 
-  printf("Matrix A:\n");
-  print_matrix(mA, N, N);
+  if (N <= PRINT_MAX_N) {
+    printf("Matrix A:\n");
+    print_matrix(mA, N, N);
 
-  printf("\nMatrix B:\n");
-  print_matrix(mB, N, N);
-  printf("\n");
+    printf("\nMatrix B:\n");
+    print_matrix(mB, N, N);
+    printf("\n");
+  }
 
-  for (int i = 0; i < N; ++i) {
-    for (int j = 0; j < N; ++j) {
+  // Enough rows for every thread to get a GEMM_MC block.
+  int block_rows = GEMM_MC * omp_get_max_threads();
+  if (!pipeline) block_rows = N;
 
-      mX[i][j] = 0;
-      for (int k = 0; k < N; ++k) {
-        mX[i][j] += mA[i][k] * mB[k][j];
+  double elapsed = 0.0;
+  memset(mX, 0, sizeof(float) * N * N);
+
+  for (int first = 0; first < N; first += block_rows) {
+    int rows = (N - first < block_rows) ? N - first : block_rows;
+
+    double t = MPI_Wtime();
+    gemm_sgemm(rows, N, N, &mA[first * N], N, mB, N, &mX[first * N], N);
+    elapsed += MPI_Wtime() - t;
+
+    for (i = first; i < first + rows; ++i) {
+      if (N <= PRINT_MAX_N) {
+        printf("[%d] Row %d of mX:", my_rank, i);
+        print_array(&mX[i * N], N);
       }
-    }
 
-    printf("[%d] Row %d of mX:", my_rank, i);
-    print_array(mX[i], N);
+      // No-op unless the send that used this slot is still in flight.
+      MPI_Wait(&requests[i % nrequests], MPI_STATUS_IGNORE);
+      MPI_Isend(&mX[i * N], N, MPI_FLOAT, 0, i, MPI_COMM_WORLD,
+                &requests[i % nrequests]);
+    }
 
-    MPI_Isend(mX[i], N, MPI_FLOAT, 0, i, MPI_COMM_WORLD, &requests[i]);
+    if (pipeline) {
+      int done;
+      MPI_Testsome(nrequests, requests, &done, indices, MPI_STATUSES_IGNORE);
+    }
   }
 
-  for (i = 0; i < N; ++i) {
-    printf("[%d] Waiting for row %d\n", my_rank, i);
-    MPI_Wait(&requests[i], MPI_STATUS_IGNORE);
-  }
+  printf("[%d] X = A * B in %.4fs (%.2f GFLOP/s)\n", my_rank, elapsed,
+         2.0 * N * N * N / elapsed * 1e-9);
+
+  MPI_Waitall(nrequests, requests, MPI_STATUSES_IGNORE);
+
+  free(mA);
+  free(mB);
+  free(mX);
+  free(requests);
+  free(indices);
 }
 
-void task_master(int my_rank) {
-  int i, j, k;
+/**
+ * Posts the receives of row i of X, Y and Z into slot `slot` of the buffers.
+ */
+void post_row(float* buffers, MPI_Request* requests, int slot, int i) {
+  for (int m = 0; m < 3; ++m) {
+    MPI_Irecv(&buffers[(3 * slot + m) * N], N, MPI_FLOAT, m + 1, i,
+              MPI_COMM_WORLD, &requests[3 * slot + m]);
+  }
+}
 
-  float mT[N][N];
-  float mW[N][N];
-  float rowX[N];
-  float rowY[N];
-  float rowZ[N];
-  float row[N];
-  MPI_Request requestX;
-  MPI_Request requestY;
-  MPI_Request requestZ;
+/**
+ * Receives the rows of X, Y and Z and computes W = (X + Y + Z) * T.
+ *
+ * Synchronous: posts the receives of row i and waits for them right away, so
+ * nothing overlaps.
+ *
+ * Pipelined: `window` rows are received into their own buffers. The receives
+ * of rows 0 .. window - 1 are posted up front, and as soon as row i has been
+ * summed its buffers are reposted for row i + window, before the row times T
+ * is computed. Root then only waits when the senders are behind.
+ *
+ * Returns the time root spent waiting for rows and computing.
+ */
+void task_master(int my_rank, int pipeline, int window, double* wait_time,
+                 double* compute_time) {
+  int i, j;
+  int slots = pipeline ? window : 1;
+
+  float* mT = (float*)malloc(sizeof(float) * N * N);
+  float* mW = (float*)malloc(sizeof(float) * N * N);
+  float* buffers = (float*)malloc(sizeof(float) * 3 * N * slots);
+  float* row = (float*)malloc(sizeof(float) * N);
+  MPI_Request* requests = (MPI_Request*)malloc(sizeof(MPI_Request) * 3 * slots);
+  assert(mT != NULL && mW != NULL && buffers != NULL && row != NULL &&
+         requests != NULL);
 
   for (i = 0; i < N; ++i) {
     for (j = 0; j < N; ++j) {
-      mT[i][j] = 0.0;
-      if (i == j) mT[i][j] = 1.0;
+      mT[i * N + j] = 0.0;
+      if (i == j) mT[i * N + j] = 1.0;
     }
   }
 
-  printf("\nMatrix T:\n");
-  print_matrix(mT, N, N);
-  printf("\n");
+  if (N <= PRINT_MAX_N) {
+    printf("\nMatrix T:\n");
+    print_matrix(mT, N, N);
+    printf("\n");
+  }
+
+  memset(mW, 0, sizeof(float) * N * N);
+  *wait_time = 0.0;
+  *compute_time = 0.0;
+
+  if (pipeline) {
+    for (i = 0; i < slots && i < N; ++i) post_row(buffers, requests, i, i);
+  }
 
   for (i = 0; i < N; ++i) {
-    MPI_Irecv(rowX, N, MPI_FLOAT, 1, i, MPI_COMM_WORLD, &requestX);
-    MPI_Irecv(rowY, N, MPI_FLOAT, 2, i, MPI_COMM_WORLD, &requestY);
-    MPI_Irecv(rowZ, N, MPI_FLOAT, 3, i, MPI_COMM_WORLD, &requestZ);
-    MPI_Wait(&requestX, MPI_STATUS_IGNORE);
-    MPI_Wait(&requestY, MPI_STATUS_IGNORE);
-    MPI_Wait(&requestZ, MPI_STATUS_IGNORE);
+    int slot = i % slots;
+    float* rowX = &buffers[(3 * slot + 0) * N];
+    float* rowY = &buffers[(3 * slot + 1) * N];
+    float* rowZ = &buffers[(3 * slot + 2) * N];
+
+    double start = MPI_Wtime();
+    if (!pipeline) post_row(buffers, requests, slot, i);
+    MPI_Waitall(3, &requests[3 * slot], MPI_STATUSES_IGNORE);
+    *wait_time += MPI_Wtime() - start;
 
      // W = (X + Y + Z) * T
 
-    printf("[%d] Received row %d of mX: ", my_rank, i);
-    print_array(rowX, N);
+    if (N <= PRINT_MAX_N) {
+      printf("[%d] Received row %d of mX: ", my_rank, i);
+      print_array(rowX, N);
 
-    printf("[%d] Received row %d of mY: ", my_rank, i);
-    print_array(rowY, N);
+      printf("[%d] Received row %d of mY: ", my_rank, i);
+      print_array(rowY, N);
 
-    printf("[%d] Received row %d of mZ: ", my_rank, i);
-    print_array(rowZ, N);
+      printf("[%d] Received row %d of mZ: ", my_rank, i);
+      print_array(rowZ, N);
+    }
+
+    start = MPI_Wtime();
 
     // Sum rows X, Y and Z.
     for (j = 0; j < N; ++j) {
       row[j] = rowX[j] + rowY[j] + rowZ[j];
-      mW[i][j] = 0;
     }
 
-    // Calculate a row of mW.
-    for (j = 0; j < N; ++j) {
-      for (k = 0; k < N; ++k) {
-        mW[i][j] += row[j] * mT[k][j];
+    // The slot is free again: start receiving a later row into it.
+    if (pipeline && i + slots < N) post_row(buffers, requests, slot, i + slots);
+
+    // Calculate a row of mW: the 1 x N row times T, reading T by rows.
+    float* w = &mW[i * N];
+    for (int k = 0; k < N; ++k) {
+      const float* t = &mT[k * N];
+      #pragma omp simd
+      for (j = 0; j < N; ++j) {
+        w[j] += row[k] * t[j];
       }
     }
+
+    *compute_time += MPI_Wtime() - start;
+  }
+
+  if (N <= PRINT_MAX_N) {
+    printf("\nMatrix W:\n");
+    print_matrix(mW, N, N);
+  }
+  else {
+    double sum = 0.0;
+    for (i = 0; i < N * N; ++i) sum += mW[i];
+    printf("[%d] W computed, W[0][0] = %f, sum of W = %.6e\n", my_rank, mW[0],
+           sum);
+  }
+
+  free(mT);
+  free(mW);
+  free(buffers);
+  free(row);
+  free(requests);
+}
+
+/**
+ * Computes W once, in the given mode, and returns the time it took (on the
+ * slowest rank). On root, also the time spent waiting for rows and computing.
+ */
+double run(int my_rank, int pipeline, int window, double* wait_time,
+           double* compute_time) {
+  // Same matrices in every run.
+  srand(SEED + my_rank);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  double elapsed = -MPI_Wtime();
+
+  if (my_rank == 0) {
+    task_master(my_rank, pipeline, window, wait_time, compute_time);
   }
+  else {
+    task_ABX(my_rank, pipeline, window);
+  }
+
+  elapsed += MPI_Wtime();
 
-  printf("\nMatrix W:\n");
-  print_matrix(mW, N, N);
+  double max_elapsed;
+  MPI_Allreduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX,
+                MPI_COMM_WORLD);
+  return max_elapsed;
 }
 
 /**
@@ -161,21 +322,53 @@ int main(int argc, char** argv) {
   MPI_Comm_size(MPI_COMM_WORLD, &world_size);
   MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 
+  const char* mode = "sync";
+  int window = WINDOW;
+  if (argc > 1) N = atoi(argv[1]);
+  if (argc > 2) mode = argv[2];
+  if (argc > 3) window = atoi(argv[3]);
+
   if (world_size != 4) {
     fprintf(stderr, "This program needs exactly 4 processes to run.\n");
     MPI_Abort(MPI_COMM_WORLD, 1);
   }
+  if (window < 1 || (strcmp(mode, "sync") != 0 &&
+                     strcmp(mode, "pipeline") != 0 &&
+                     strcmp(mode, "compare") != 0)) {
+    if (my_rank == 0) {
+      fprintf(stderr, "Usage: %s [N] [sync|pipeline|compare] [window]\n",
+              argv[0]);
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
 
-  // Make sure different ranks get different random values.
-  srand(time(NULL) + my_rank);
+  double wait_time[2], compute_time[2], elapsed[2];
+  int runs[2] = { strcmp(mode, "pipeline") != 0,    // Synchronous.
+                  strcmp(mode, "sync") != 0 };      // Pipelined.
 
-  if (my_rank == 0) {
-    task_master(my_rank);
-  }
-  else {
-    task_ABX(my_rank);
+  for (int pipeline = 0; pipeline < 2; ++pipeline) {
+    if (!runs[pipeline]) continue;
+
+    elapsed[pipeline] = run(my_rank, pipeline, window, &wait_time[pipeline],
+                            &compute_time[pipeline]);
+
+    if (my_rank == 0) {
+      printf("[%d] %s: W in %.4fs; root waited %.4fs for rows and computed "
+             "for %.4fs\n", my_rank,
+             pipeline ? "pipelined" : "synchronous", elapsed[pipeline],
+             wait_time[pipeline], compute_time[pipeline]);
+    }
   }
 
+  // Time saved by overlapping root's work (and the transfers) with the
+  // senders' products.
+  if (my_rank == 0 && runs[0] && runs[1]) {
+    printf("[%d] Pipelined (window %d) vs synchronous: speedup %.2fx, %.4fs "
+           "saved; root waited %.0f%% of the time vs %.0f%%\n", my_rank,
+           window, elapsed[0] / elapsed[1], elapsed[0] - elapsed[1],
+           100.0 * wait_time[1] / elapsed[1],
+           100.0 * wait_time[0] / elapsed[0]);
+  }
 
   // Clean up.
   MPI_Finalize();
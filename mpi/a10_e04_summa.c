@@ -0,0 +1,272 @@
+/**
+ * Distributed matrix multiplication, C = A * B, with SUMMA on a 2D grid of
+ * processes.
+ *
+ * a10_e03_matrix_multiplication.c needs exactly 4 processes, and every
+ * multiplying rank holds whole matrices. Here the p processes form a q x q
+ * grid (p must be a perfect square) with MPI_Cart_create, and each of A, B
+ * and C is split in q x q blocks (partition.h, so n doesn't have to be a
+ * multiple of q): process (i, j) only ever holds block (i, j) of each matrix,
+ * plus one block of A and one of B in transit. The memory per process is
+ * about 3 n^2 / p floats, so matrices larger than one node fit when spread
+ * over enough nodes.
+ *
+ * SUMMA (van de Geijn and Watts, 1997) does q steps. In step k, the processes
+ * in grid column k broadcast their block of A along their grid row, the
+ * processes in grid row k broadcast their block of B along their grid column,
+ * and every process adds A(i, k) * B(k, j) to its C(i, j) with the kernel of
+ * openmp/gemm.h (so each process can use several threads).
+ *
+ * With "overlap", the broadcasts of step k + 1 are started with MPI_Ibcast
+ * before the multiplication of step k, so communication and computation can
+ * overlap.
+ *
+ * A and B are generated from the counter-based generator in
+ * openmp/parallel_rng.h, by global position, so every process generates its
+ * own blocks, and can also compute any element of C on its own to check
+ * SAMPLES entries of its block.
+ *
+ * Compile & run:
+ * $ mpicc -O2 -fopenmp -o a10_e04_summa a10_e04_summa.c -lm
+ * $ OMP_NUM_THREADS=2 mpiexec -n 4 ./a10_e04_summa 4096
+ * $ mpiexec -n 9 ./a10_e04_summa 3000 overlap
+ */
+
+#include <assert.h>
+#include <math.h>     /* sqrt, fabs */
+#include <mpi.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atol */
+#include <string.h>   /* memset, strcmp */
+
+#include "../openmp/gemm.h"
+#include "../openmp/parallel_rng.h"
+#include "partition.h"
+
+#define N       2048
+#define SAMPLES 16
+#define SEED_A  12345
+#define SEED_B  54321
+
+// Relative tolerance of the float result against the double one.
+#define TOLERANCE 1e-4
+
+static inline float element(uint64_t seed, long n, long i, long j) {
+  return (float)rng_uniform(seed, (uint64_t)(i * n + j)) - 0.5f;
+}
+
+/**
+ * Fills the block [r0, r1) x [c0, c1) of the n x n matrix with `seed`.
+ */
+void generate_block(float* block, uint64_t seed, long n, long r0, long r1,
+                    long c0, long c1) {
+  long i;
+  #pragma omp parallel for schedule(static)
+  for (i = r0; i < r1; ++i) {
+    for (long j = c0; j < c1; ++j) {
+      block[(i - r0) * (c1 - c0) + (j - c0)] = element(seed, n, i, j);
+    }
+  }
+}
+
+/**
+ * Starts the broadcast of a block of `count` floats (any count).
+ */
+void start_bcast(float* buf, long count, int root, MPI_Comm comm,
+                 MPI_Request* request, MPI_Datatype* type) {
+  partition_big_type(count, MPI_FLOAT, type);
+  MPI_Ibcast(buf, 1, *type, root, comm, request);
+}
+
+void finish_bcast(MPI_Request* request, MPI_Datatype* type) {
+  MPI_Wait(request, MPI_STATUS_IGNORE);
+  MPI_Type_free(type);
+}
+
+/**
+ * Checks SAMPLES entries of the C block against dot products in double.
+ */
+int check_block(const float* C, long n, long r0, long r1, long c0, long c1,
+                int rank) {
+  long rows = r1 - r0, cols = c1 - c0;
+  if (rows == 0 || cols == 0) return 1;
+
+  for (int s = 0; s < SAMPLES; ++s) {
+    long i = r0 + rng_bounded(rng_u64(rank, 2 * s), rows);
+    long j = c0 + rng_bounded(rng_u64(rank, 2 * s + 1), cols);
+    double ref = 0.0, norm = 0.0;
+
+    for (long k = 0; k < n; ++k) {
+      double t = (double)element(SEED_A, n, i, k) * element(SEED_B, n, k, j);
+      ref += t;
+      norm += fabs(t);
+    }
+    if (fabs(C[(i - r0) * cols + (j - c0)] - ref) > TOLERANCE * norm) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+
+  // Only the main thread of each rank calls MPI.
+  int provided;
+  MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+
+  int world_size, my_rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+  if (provided < MPI_THREAD_FUNNELED) {
+    if (my_rank == 0) {
+      fprintf(stderr, "The MPI library doesn't support MPI_THREAD_FUNNELED.\n");
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  long n = N;
+  int overlap = 0;
+  if (argc > 1) n = atol(argv[1]);
+  if (argc > 2) overlap = (strcmp(argv[2], "overlap") == 0);
+
+  int q = (int)(sqrt((double)world_size) + 0.5);
+  if (q * q != world_size || n < q) {
+    fprintf(stderr, "The number of processes must be a perfect square, and n "
+            "at least its square root (used: %d processes, n = %ld)\n",
+            world_size, n);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  // The q x q grid, and a communicator for my grid row and my grid column.
+  int dims[2] = { q, q }, periods[2] = { 0, 0 }, coords[2];
+  int keep_cols[2] = { 0, 1 }, keep_rows[2] = { 1, 0 };
+  MPI_Comm grid, row_comm, col_comm;
+
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &grid);
+  MPI_Comm_rank(grid, &my_rank);  // The grid may reorder the ranks.
+  MPI_Cart_coords(grid, my_rank, 2, coords);
+  MPI_Cart_sub(grid, keep_cols, &row_comm);  // Rank in it = my grid column.
+  MPI_Cart_sub(grid, keep_rows, &col_comm);  // Rank in it = my grid row.
+
+  // My blocks: rows [r0, r1) and columns [c0, c1) of C. My block of A has my
+  // rows and the k range of my column; my block of B, the k range of my row
+  // and my columns.
+  long r0, r1, c0, c1;
+  partition_block(n, q, coords[0], &r0, &r1);
+  partition_block(n, q, coords[1], &c0, &c1);
+  long rows = r1 - r0, cols = c1 - c0;
+  long max_block = (n + q - 1) / q;
+
+  float* A = (float*)malloc(sizeof(float) * rows * cols);
+  float* B = (float*)malloc(sizeof(float) * rows * cols);
+  float* C = (float*)malloc(sizeof(float) * rows * cols);
+  float* a_panel[2];
+  float* b_panel[2];
+  for (int b = 0; b < 2; ++b) {
+    a_panel[b] = (float*)malloc(sizeof(float) * rows * max_block);
+    b_panel[b] = (float*)malloc(sizeof(float) * max_block * cols);
+    assert(a_panel[b] != NULL && b_panel[b] != NULL);
+  }
+  assert(A != NULL && B != NULL && C != NULL);
+
+  generate_block(A, SEED_A, n, r0, r1, c0, c1);
+  generate_block(B, SEED_B, n, r0, r1, c0, c1);
+  memset(C, 0, sizeof(float) * rows * cols);
+
+  double comm_time = 0.0, compute_time = 0.0;
+  MPI_Request requests[2];
+  MPI_Datatype types[2];
+
+  MPI_Barrier(grid);
+  double elapsed = -MPI_Wtime();
+
+  for (int k = 0; k < q; ++k) {
+    int cur = k % 2;
+    long k0, k1;
+    partition_block(n, q, k, &k0, &k1);
+    long width = k1 - k0;
+
+    // The owners broadcast straight from their own blocks.
+    float* a = (coords[1] == k) ? A : a_panel[cur];
+    float* b = (coords[0] == k) ? B : b_panel[cur];
+
+    double t = MPI_Wtime();
+    if (!overlap || k == 0) {
+      start_bcast(a, rows * width, k, row_comm, &requests[0], &types[0]);
+      start_bcast(b, width * cols, k, col_comm, &requests[1], &types[1]);
+    }
+    finish_bcast(&requests[0], &types[0]);
+    finish_bcast(&requests[1], &types[1]);
+
+    // Start the next step's broadcasts into the other buffers.
+    if (overlap && k + 1 < q) {
+      long n0, n1;
+      partition_block(n, q, k + 1, &n0, &n1);
+      float* a_next = (coords[1] == k + 1) ? A : a_panel[1 - cur];
+      float* b_next = (coords[0] == k + 1) ? B : b_panel[1 - cur];
+      start_bcast(a_next, rows * (n1 - n0), k + 1, row_comm, &requests[0],
+                  &types[0]);
+      start_bcast(b_next, (n1 - n0) * cols, k + 1, col_comm, &requests[1],
+                  &types[1]);
+    }
+    comm_time += MPI_Wtime() - t;
+
+    t = MPI_Wtime();
+    gemm_sgemm((int)rows, (int)cols, (int)width, a, (int)width, b, (int)cols,
+               C, (int)cols);
+    compute_time += MPI_Wtime() - t;
+  }
+
+  elapsed += MPI_Wtime();
+
+  int ok = check_block(C, n, r0, r1, c0, c1, my_rank);
+
+  // Per-process report, on root.
+  double mine[4] = { elapsed, compute_time, comm_time,
+                     2.0 * rows * cols * n / compute_time * 1e-9 };
+  double* all = NULL;
+  int all_ok;
+  if (my_rank == 0) {
+    all = (double*)malloc(sizeof(double) * 4 * world_size);
+    assert(all != NULL);
+  }
+  MPI_Gather(mine, 4, MPI_DOUBLE, all, 4, MPI_DOUBLE, 0, grid);
+  MPI_Reduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, 0, grid);
+
+  if (my_rank == 0) {
+    double max_elapsed = 0.0;
+    printf("n = %ld, grid = %d x %d, threads per rank = %d, overlap = %s\n",
+           n, q, q, omp_get_max_threads(), overlap ? "yes" : "no");
+    printf("rank,row,col,time_s,compute_s,comm_s,compute_GFLOP_per_s\n");
+    for (int r = 0; r < world_size; ++r) {
+      int rc[2];
+      MPI_Cart_coords(grid, r, 2, rc);
+      printf("%d,%d,%d,%.4f,%.4f,%.4f,%.2f\n", r, rc[0], rc[1], all[4 * r],
+             all[4 * r + 1], all[4 * r + 2], all[4 * r + 3]);
+      if (all[4 * r] > max_elapsed) max_elapsed = all[4 * r];
+    }
+    printf("Total: %.4fs, %.2f GFLOP/s. Check: %s\n", max_elapsed,
+           2.0 * n * n * n / max_elapsed * 1e-9, all_ok ? "ok" : "WRONG");
+    free(all);
+  }
+
+  // Clean up.
+  free(A);
+  free(B);
+  free(C);
+  for (int b = 0; b < 2; ++b) {
+    free(a_panel[b]);
+    free(b_panel[b]);
+  }
+  MPI_Comm_free(&row_comm);
+  MPI_Comm_free(&col_comm);
+  MPI_Comm_free(&grid);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * Distributed histogram with MPI_Reduce_scatter.
+ *
+ * Each rank generates its own share of the samples and counts them. The
+ * local counts are then combined with MPI_Reduce_scatter, which sums them
+ * across ranks *and* leaves each rank with the totals of a contiguous range of
+ * buckets only. So the final histogram is spread over all ranks, instead of
+ * having to fit on the root.
+ *
+ * To bound the memory needed for the local counts as well, the reduction can
+ * be done in rounds: in each round, every rank counts only `slice` buckets of
+ * every rank's range, so the local buffer has at most world_size * slice
+ * counters. The default is one round (slice = the largest range).
+ *
+ * The samples come from the counter-based generator in
+ * openmp/parallel_rng.h, indexed by their global position, so the histogram
+ * is the same for any number of ranks.
+ *
+ * Compile & run:
+ * $ mpicc -O2 -fopenmp -o histogram_reduce_scatter histogram_reduce_scatter.c
+ * $ mpiexec -n 4 ./histogram_reduce_scatter [nbuckets] [nvals] [slice] [gather]
+ *
+ * Pass "gather" as the 4th argument to also collect the whole histogram on
+ * root with MPI_Gatherv.
+ */
+
+#include <assert.h>
+#include <limits.h>   /* INT_MAX */
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atol */
+#include <string.h>   /* memset, strcmp */
+
+#include "../openmp/parallel_rng.h"
+#include "partition.h"
+
+#define NBUCKETS 1000000
+#define NVALS    10000000
+#define SEED     12345
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+
+  // Initialize MPI.
+  MPI_Init(NULL, NULL);
+
+  int world_size, my_rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+  long nbuckets = NBUCKETS;
+  long nvals = NVALS;
+  long slice = 0;
+  int gather = 0;
+
+  if (argc > 1) nbuckets = atol(argv[1]);
+  if (argc > 2) nvals = atol(argv[2]);
+  if (argc > 3) slice = atol(argv[3]);
+  if (argc > 4) gather = (strcmp(argv[4], "gather") == 0);
+
+  // rng_bounded() takes the number of buckets as an int.
+  if (nbuckets < world_size || nbuckets > INT_MAX || nvals <= 0) {
+    if (my_rank == 0) {
+      fprintf(stderr, "Usage: %s [nbuckets] [nvals] [slice] [gather]\n"
+              "(nbuckets must be at least the number of processes)\n",
+              argv[0]);
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  // Buckets owned by every rank, and the largest range.
+  long* own_begin = (long*)malloc(sizeof(long) * world_size);
+  long* own_end = (long*)malloc(sizeof(long) * world_size);
+  assert(own_begin != NULL && own_end != NULL);
+
+  long max_owned = 0;
+  for (int r = 0; r < world_size; ++r) {
+    partition_block(nbuckets, world_size, r, &own_begin[r], &own_end[r]);
+    if (own_end[r] - own_begin[r] > max_owned) {
+      max_owned = own_end[r] - own_begin[r];
+    }
+  }
+
+  if (slice <= 0 || slice > max_owned) slice = max_owned;
+  int rounds = (int)((max_owned + slice - 1) / slice);
+
+  // My share of the samples.
+  long val_begin, val_end;
+  partition_block(nvals, world_size, my_rank, &val_begin, &val_end);
+  long nlocal = val_end - val_begin;
+
+  int* samples = (int*)malloc(sizeof(int) * (nlocal > 0 ? nlocal : 1));
+  assert(samples != NULL);
+  for (long i = 0; i < nlocal; ++i) {
+    samples[i] = rng_bounded(rng_u64(SEED, (uint64_t)(val_begin + i)),
+                             (int)nbuckets);
+  }
+
+  // The histogram buckets this rank owns.
+  long my_owned = own_end[my_rank] - own_begin[my_rank];
+  long* my_hist = (long*)malloc(sizeof(long) * my_owned);
+
+  // Per-round buffers: local counts for `slice` buckets of every rank.
+  long* local = (long*)malloc(sizeof(long) * world_size * slice);
+  int* recvcounts = (int*)malloc(sizeof(int) * world_size);
+  long* displs = (long*)malloc(sizeof(long) * world_size);
+  assert(my_hist != NULL && local != NULL && recvcounts != NULL &&
+         displs != NULL);
+
+  double elapsed = -MPI_Wtime();
+
+  for (int round = 0; round < rounds; ++round) {
+    long offset = round * slice;
+    long pos = 0;
+
+    // Slice of every rank's range that is reduced in this round.
+    for (int r = 0; r < world_size; ++r) {
+      long len = (own_end[r] - own_begin[r]) - offset;
+      if (len < 0) len = 0;
+      if (len > slice) len = slice;
+      recvcounts[r] = (int)len;
+      displs[r] = pos;
+      pos += len;
+    }
+
+    memset(local, 0, sizeof(long) * pos);
+
+    for (long i = 0; i < nlocal; ++i) {
+      long b = samples[i];
+      int owner = partition_block_owner(nbuckets, world_size, b);
+      long rel = b - own_begin[owner] - offset;
+      if (rel >= 0 && rel < recvcounts[owner]) {
+        local[displs[owner] + rel]++;
+      }
+    }
+
+    MPI_Reduce_scatter(local, my_hist + offset, recvcounts, MPI_LONG, MPI_SUM,
+                       MPI_COMM_WORLD);
+  }
+
+  elapsed += MPI_Wtime();
+
+  // Check: the counts of all ranks must add up to nvals.
+  long my_total = 0, total = 0;
+  for (long b = 0; b < my_owned; ++b) my_total += my_hist[b];
+  MPI_Reduce(&my_total, &total, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  printf("[%d] Owns buckets [%ld, %ld): %ld samples\n", my_rank,
+         own_begin[my_rank], own_end[my_rank], my_total);
+
+  double max_elapsed;
+  MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  if (my_rank == 0) {
+    printf("Done in %lfs (%d round(s) of %ld bucket(s) per rank). "
+           "Total samples: %ld (%s)\n", max_elapsed, rounds, slice, total,
+           total == nvals ? "ok" : "WRONG");
+  }
+
+  // Optional: collect the whole histogram on root.
+  if (gather) {
+    long* full = NULL;
+    long* counts = (long*)malloc(sizeof(long) * world_size);
+    long* gdispls = (long*)malloc(sizeof(long) * world_size);
+    assert(counts != NULL && gdispls != NULL);
+    partition_block_counts(nbuckets, world_size, counts, gdispls);
+
+    if (my_rank == 0) {
+      full = (long*)malloc(sizeof(long) * nbuckets);
+      assert(full != NULL);
+    }
+
+    partition_gatherv(my_hist, counts, gdispls, MPI_LONG, full, 0,
+                      MPI_COMM_WORLD);
+
+    if (my_rank == 0) {
+      printf("Gathered histogram on root. First buckets:");
+      for (long b = 0; b < nbuckets && b < 5; ++b) printf(" %ld", full[b]);
+      printf("\n");
+      free(full);
+    }
+    free(counts);
+    free(gdispls);
+  }
+
+  // Clean up.
+  free(samples);
+  free(my_hist);
+  free(local);
+  free(recvcounts);
+  free(displs);
+  free(own_begin);
+  free(own_end);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * Distribution of n items (array elements, rows, buckets...) over the ranks
+ * of a communicator, with 64-bit sizes.
+ *
+ * Three distributions:
+ *
+ * - block:        rank r gets one contiguous range; sizes differ by at most
+ *                 one, and the first (n % size) ranks get the extra item.
+ * - block-cyclic: blocks of `block` items are dealt round-robin: block k goes
+ *                 to rank k % size. Balances work that grows along the array.
+ * - weighted:     contiguous ranges proportional to weights[r] (e.g. the
+ *                 measured speed of each rank), rounded so they add up to n.
+ *
+ * Counts and displacements are longs everywhere. MPI's own counts are ints,
+ * so partition_scatterv() and partition_gatherv() move more than 2^31
+ * elements per rank by describing each rank's piece with a derived datatype
+ * (partition_big_type()) and sending it point to point; when everything fits
+ * in an int they simply call MPI_Scatterv / MPI_Gatherv.
+ *
+ * Usage:
+ *
+ *   long begin, end;
+ *   partition_block(n, world_size, my_rank, &begin, &end);
+ *
+ *   long counts[world_size], displs[world_size];
+ *   partition_block_counts(n, world_size, counts, displs);
+ *   partition_scatterv(all, counts, displs, MPI_DOUBLE, mine, 0, comm);
+ */
+
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <limits.h>   /* INT_MAX */
+#include <mpi.h>
+#include <stdlib.h>   /* malloc, free */
+
+// Elements per piece when a count has to be split for MPI (see
+// partition_big_type).
+#ifndef PARTITION_BIG_CHUNK
+#define PARTITION_BIG_CHUNK (1L << 30)
+#endif
+
+/**
+ * Block distribution: range [begin, end) of `rank`.
+ */
+static inline void partition_block(long n, int size, int rank, long* begin,
+                                   long* end) {
+  long chunk = n / size;
+  long rem = n % size;
+  *begin = rank * chunk + (rank < rem ? rank : rem);
+  *end = *begin + chunk + (rank < rem ? 1 : 0);
+}
+
+/**
+ * Block distribution: rank that owns item `i`.
+ */
+static inline int partition_block_owner(long n, int size, long i) {
+  long chunk = n / size;
+  long rem = n % size;
+  long big = rem * (chunk + 1);  // Items owned by the ranks with an extra.
+  if (i < big) return (int)(i / (chunk + 1));
+  return (int)(rem + (i - big) / chunk);
+}
+
+/**
+ * Block distribution: counts and displacements of every rank.
+ */
+static inline void partition_block_counts(long n, int size, long* counts,
+                                          long* displs) {
+  for (int r = 0; r < size; ++r) {
+    long begin, end;
+    partition_block(n, size, r, &begin, &end);
+    counts[r] = end - begin;
+    displs[r] = begin;
+  }
+}
+
+/**
+ * Block-cyclic distribution: rank that owns item `i`.
+ */
+static inline int partition_cyclic_owner(long block, int size, long i) {
+  return (int)((i / block) % size);
+}
+
+/**
+ * Block-cyclic distribution: number of items `rank` owns.
+ */
+static inline long partition_cyclic_count(long n, long block, int size,
+                                          int rank) {
+  long nblocks = n / block;          // Full blocks.
+  long tail = n % block;             // Items in the last, partial block.
+  long count = (nblocks / size) * block;
+  long extra = nblocks % size;       // Ranks with one more full block.
+
+  if (rank < extra) count += block;
+  else if (rank == extra) count += tail;
+  return count;
+}
+
+/**
+ * Block-cyclic distribution: global index of the `local`-th item of `rank`.
+ */
+static inline long partition_cyclic_global(long local, long block, int size,
+                                           int rank) {
+  long round = local / block;
+  return (round * size + rank) * block + local % block;
+}
+
+/**
+ * Weighted distribution: contiguous ranges with sizes proportional to
+ * weights[r] (which must be >= 0, and not all 0). Every rank's range starts
+ * at round(n * (weights[0] + ... + weights[r - 1]) / total), so the error of
+ * each count is below one item and they add up to n.
+ */
+static inline void partition_weighted_counts(long n, int size,
+                                             const double* weights,
+                                             long* counts, long* displs) {
+  double total = 0.0, prefix = 0.0;
+  long begin = 0;
+
+  for (int r = 0; r < size; ++r) total += weights[r];
+
+  for (int r = 0; r < size; ++r) {
+    long end;
+    prefix += weights[r];
+    end = (r == size - 1) ? n : (long)(n * (prefix / total) + 0.5);
+    if (end < begin) end = begin;
+    if (end > n) end = n;
+    counts[r] = end - begin;
+    displs[r] = begin;
+    begin = end;
+  }
+}
+
+/**
+ * Creates (and commits) a datatype for `count` consecutive elements of
+ * `type`, for any count: pieces of PARTITION_BIG_CHUNK elements, plus the
+ * rest. Send or receive exactly one of it. Free it with MPI_Type_free.
+ */
+static inline void partition_big_type(long count, MPI_Datatype type,
+                                      MPI_Datatype* big) {
+  if (count <= INT_MAX) {
+    MPI_Type_contiguous((int)count, type, big);
+  }
+  else {
+    long pieces = count / PARTITION_BIG_CHUNK;
+    long rest = count % PARTITION_BIG_CHUNK;
+    MPI_Aint lb, extent;
+    MPI_Datatype piece, body, tail;
+
+    MPI_Type_get_extent(type, &lb, &extent);
+    MPI_Type_contiguous((int)PARTITION_BIG_CHUNK, type, &piece);
+    MPI_Type_contiguous((int)pieces, piece, &body);
+    MPI_Type_contiguous((int)rest, type, &tail);
+
+    int lengths[2] = { 1, 1 };
+    MPI_Aint offsets[2] = { 0, (MPI_Aint)(pieces * PARTITION_BIG_CHUNK)
+                               * extent };
+    MPI_Datatype types[2] = { body, tail };
+    MPI_Type_create_struct(2, lengths, offsets, types, big);
+
+    MPI_Type_free(&piece);
+    MPI_Type_free(&body);
+    MPI_Type_free(&tail);
+  }
+  MPI_Type_commit(big);
+}
+
+/**
+ * 1 if every count and displacement fits in an int.
+ */
+static inline int partition_fits_int(const long* counts, const long* displs,
+                                     int size) {
+  for (int r = 0; r < size; ++r) {
+    if (counts[r] > INT_MAX || displs[r] > INT_MAX) return 0;
+  }
+  return 1;
+}
+
+/**
+ * MPI_Scatterv with long counts and displacements (in elements of `type`).
+ * counts and displs are needed on every rank (not only on root), so that all
+ * ranks agree on which path to take. Rank r receives counts[r] elements.
+ */
+static inline void partition_scatterv(const void* sendbuf, const long* counts,
+                                      const long* displs, MPI_Datatype type,
+                                      void* recvbuf, int root, MPI_Comm comm) {
+  int size, rank;
+  MPI_Comm_size(comm, &size);
+  MPI_Comm_rank(comm, &rank);
+
+  if (partition_fits_int(counts, displs, size)) {
+    int* icounts = (int*)malloc(sizeof(int) * size);
+    int* idispls = (int*)malloc(sizeof(int) * size);
+    for (int r = 0; r < size; ++r) {
+      icounts[r] = (int)counts[r];
+      idispls[r] = (int)displs[r];
+    }
+    MPI_Scatterv(sendbuf, icounts, idispls, type, recvbuf, icounts[rank], type,
+                 root, comm);
+    free(icounts);
+    free(idispls);
+    return;
+  }
+
+  MPI_Aint lb, extent;
+  MPI_Type_get_extent(type, &lb, &extent);
+
+  if (rank == root) {
+    MPI_Request* requests = (MPI_Request*)malloc(sizeof(MPI_Request) * size);
+    MPI_Datatype* types = (MPI_Datatype*)malloc(sizeof(MPI_Datatype) * size);
+
+    for (int r = 0; r < size; ++r) {
+      const char* piece = (const char*)sendbuf + displs[r] * extent;
+      partition_big_type(counts[r], type, &types[r]);
+      if (r == root) {
+        MPI_Sendrecv(piece, 1, types[r], root, 0, recvbuf, 1, types[r], root,
+                     0, comm, MPI_STATUS_IGNORE);
+        requests[r] = MPI_REQUEST_NULL;
+      }
+      else {
+        MPI_Isend(piece, 1, types[r], r, 0, comm, &requests[r]);
+      }
+    }
+    MPI_Waitall(size, requests, MPI_STATUSES_IGNORE);
+
+    for (int r = 0; r < size; ++r) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+  else {
+    MPI_Datatype mine;
+    partition_big_type(counts[rank], type, &mine);
+    MPI_Recv(recvbuf, 1, mine, root, 0, comm, MPI_STATUS_IGNORE);
+    MPI_Type_free(&mine);
+  }
+}
+
+/**
+ * MPI_Gatherv with long counts and displacements; the inverse of
+ * partition_scatterv(). Rank r sends counts[r] elements.
+ */
+static inline void partition_gatherv(const void* sendbuf, const long* counts,
+                                     const long* displs, MPI_Datatype type,
+                                     void* recvbuf, int root, MPI_Comm comm) {
+  int size, rank;
+  MPI_Comm_size(comm, &size);
+  MPI_Comm_rank(comm, &rank);
+
+  if (partition_fits_int(counts, displs, size)) {
+    int* icounts = (int*)malloc(sizeof(int) * size);
+    int* idispls = (int*)malloc(sizeof(int) * size);
+    for (int r = 0; r < size; ++r) {
+      icounts[r] = (int)counts[r];
+      idispls[r] = (int)displs[r];
+    }
+    MPI_Gatherv(sendbuf, icounts[rank], type, recvbuf, icounts, idispls, type,
+                root, comm);
+    free(icounts);
+    free(idispls);
+    return;
+  }
+
+  MPI_Aint lb, extent;
+  MPI_Type_get_extent(type, &lb, &extent);
+
+  if (rank == root) {
+    MPI_Request* requests = (MPI_Request*)malloc(sizeof(MPI_Request) * size);
+    MPI_Datatype* types = (MPI_Datatype*)malloc(sizeof(MPI_Datatype) * size);
+
+    for (int r = 0; r < size; ++r) {
+      char* piece = (char*)recvbuf + displs[r] * extent;
+      partition_big_type(counts[r], type, &types[r]);
+      if (r == root) {
+        MPI_Sendrecv(sendbuf, 1, types[r], root, 0, piece, 1, types[r], root,
+                     0, comm, MPI_STATUS_IGNORE);
+        requests[r] = MPI_REQUEST_NULL;
+      }
+      else {
+        MPI_Irecv(piece, 1, types[r], r, 0, comm, &requests[r]);
+      }
+    }
+    MPI_Waitall(size, requests, MPI_STATUSES_IGNORE);
+
+    for (int r = 0; r < size; ++r) MPI_Type_free(&types[r]);
+    free(requests);
+    free(types);
+  }
+  else {
+    MPI_Datatype mine;
+    partition_big_type(counts[rank], type, &mine);
+    MPI_Send(sendbuf, 1, mine, root, 0, comm);
+    MPI_Type_free(&mine);
+  }
+}
+
+#endif  // PARTITION_H
@@ -0,0 +1,139 @@
+/**
+ * Hybrid MPI + OpenMP calculation of pi.
+ *
+ * The range of steps is split into one contiguous block per rank. Inside each
+ * rank, the block is integrated with the OpenMP reduction kernel of
+ * openmp/pi_omp_v3_reduction.c, and the partial sums of all ranks are then
+ * combined with MPI_Reduce (result on root only) or MPI_Allreduce (result on
+ * every rank).
+ *
+ * Two scaling modes:
+ * - strong: num_steps is the total number of steps, shared by all ranks.
+ * - weak:   num_steps is the number of steps *per rank*, so the total grows
+ *           with the number of ranks.
+ *
+ * Root prints one CSV line per run (header with the first run), so the runs
+ * below can be appended to the same file.
+ *
+ * Compile:
+ * mpicc -O2 -fopenmp -o pi_hybrid pi_hybrid.c -lm
+ *
+ * Strong scaling on localhost, 2 threads per rank:
+ * for n in 1 2 4 8; do
+ *   OMP_NUM_THREADS=2 mpiexec -n $n ./pi_hybrid strong 400000000 $n
+ * done
+ *
+ * Weak scaling on localhost, 2 threads per rank:
+ * for n in 1 2 4 8; do
+ *   OMP_NUM_THREADS=2 mpiexec -n $n ./pi_hybrid weak 100000000 $n
+ * done
+ *
+ * Usage:
+ * ./pi_hybrid [strong|weak] [num_steps] [print_header] [allreduce]
+ * The CSV header is only printed when print_header is 1, which is why the
+ * loops above pass $n.
+ */
+
+#include <math.h>     /* fabs */
+#include <mpi.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* atol, atoi */
+#include <string.h>   /* strcmp */
+
+#include "partition.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * Integrates 4 / (1 + x^2) over steps [begin, end) with an OpenMP reduction.
+ * @return The (unscaled) sum of the steps.
+ */
+double local_sum(long begin, long end, double step) {
+  double x, sum = 0.0;
+  long i;
+
+  #pragma omp parallel for private(x) reduction(+:sum)
+  for (i = begin; i < end; ++i) {
+    x = (i + 0.5) * step;
+    sum += 4.0 / (1.0 + x * x);
+  }
+
+  return sum;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  int weak = 0;
+  long num_steps = 400000000;
+  int print_header = 1;
+  int use_allreduce = 0;
+
+  if (argc > 1) weak = (strcmp(argv[1], "weak") == 0);
+  if (argc > 2) num_steps = atol(argv[2]);
+  if (argc > 3) print_header = (atoi(argv[3]) == 1);
+  if (argc > 4) use_allreduce = (strcmp(argv[4], "allreduce") == 0);
+
+  // Only the master thread of each rank calls MPI.
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+  int my_rank, world_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+  if (provided < MPI_THREAD_FUNNELED) {
+    if (my_rank == 0) {
+      fprintf(stderr, "The MPI library doesn't support MPI_THREAD_FUNNELED.\n");
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  long total_steps = weak ? num_steps * world_size : num_steps;
+  double step = 1.0 / (double)total_steps;
+
+  // Block partition: the first (total_steps % world_size) ranks get one extra
+  // step.
+  long begin, end;
+  partition_block(total_steps, world_size, my_rank, &begin, &end);
+
+  double pi = 0.0, sum, elapsed, max_elapsed;
+
+  // Start everybody at the same time.
+  MPI_Barrier(MPI_COMM_WORLD);
+  elapsed = -MPI_Wtime();
+
+  sum = local_sum(begin, end, step) * step;
+
+  if (use_allreduce) {
+    MPI_Allreduce(&sum, &pi, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  }
+  else {
+    MPI_Reduce(&sum, &pi, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  }
+
+  elapsed += MPI_Wtime();
+
+  // The run is as slow as its slowest rank.
+  MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  if (my_rank == 0) {
+    if (print_header) {
+      printf("mode,ranks,threads_per_rank,total_steps,steps_per_rank,"
+             "collective,pi,abs_error,time_s,steps_per_s\n");
+    }
+    printf("%s,%d,%d,%ld,%ld,%s,%.15f,%.3e,%.6f,%.4e\n",
+           weak ? "weak" : "strong", world_size, omp_get_max_threads(),
+           total_steps, total_steps / world_size,
+           use_allreduce ? "allreduce" : "reduce", pi, fabs(pi - M_PI),
+           max_elapsed, total_steps / max_elapsed);
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * The reductions of ../openmp/reduce.h across MPI ranks.
+ *
+ * MPI_MAXLOC and MPI_MINLOC only work on (value, int) pairs, so an index
+ * into an array of more than 2^31 elements doesn't fit, and MPI has no
+ * built-in operation for mean and variance. This header registers MPI
+ * datatypes for reduce_loc_d_t, reduce_loc_i_t and reduce_stats_t, and
+ * user-defined MPI_Ops that combine them exactly like the OpenMP
+ * `declare reduction`s do:
+ *
+ *   reduce_mpi_init();                       // After MPI_Init.
+ *
+ *   reduce_loc_d_t local = reduce_argmax_d(x, n);   // Threads in this rank.
+ *   if (local.index >= 0) local.index += my_offset; // Make it global.
+ *   reduce_loc_d_t global = reduce_mpi_argmax_d(local, MPI_COMM_WORLD);
+ *
+ *   reduce_stats_t all = reduce_mpi_stats(reduce_stats_d(x, n), comm);
+ *
+ *   reduce_mpi_free();                       // Before MPI_Finalize.
+ *
+ * Every function is an MPI_Allreduce, so all ranks get the result. The
+ * datatypes and ops are also usable directly, e.g. with MPI_Reduce or with
+ * count > 1 for element-wise reductions of arrays of partials.
+ */
+
+#ifndef REDUCE_MPI_H
+#define REDUCE_MPI_H
+
+#include <mpi.h>
+#include <stddef.h>   /* offsetof */
+
+#include "../openmp/reduce.h"
+
+static MPI_Datatype reduce_mpi_loc_d_type = MPI_DATATYPE_NULL;
+static MPI_Datatype reduce_mpi_loc_i_type = MPI_DATATYPE_NULL;
+static MPI_Datatype reduce_mpi_stats_type = MPI_DATATYPE_NULL;
+
+static MPI_Op reduce_mpi_argmax_d_op = MPI_OP_NULL;
+static MPI_Op reduce_mpi_argmin_d_op = MPI_OP_NULL;
+static MPI_Op reduce_mpi_argmax_i_op = MPI_OP_NULL;
+static MPI_Op reduce_mpi_argmin_i_op = MPI_OP_NULL;
+static MPI_Op reduce_mpi_welford_op = MPI_OP_NULL;
+
+/**
+ * Defines the MPI_User_function `reduce_mpi_combine_NAME`, which applies
+ * COMBINE(inout[k], in[k]) to every element.
+ */
+#define REDUCE_MPI_USER_FUNCTION(NAME, TYPE, COMBINE)                          \
+static void reduce_mpi_combine_##NAME(void* in, void* inout, int* len,         \
+                                      MPI_Datatype* datatype) {                \
+  TYPE* a = (TYPE*)in;                                                         \
+  TYPE* b = (TYPE*)inout;                                                      \
+  (void)datatype;                                                              \
+  for (int k = 0; k < *len; ++k) {                                             \
+    b[k] = COMBINE(b[k], a[k]);                                                \
+  }                                                                            \
+}
+
+REDUCE_MPI_USER_FUNCTION(argmax_d, reduce_loc_d_t, reduce_loc_d_max)
+REDUCE_MPI_USER_FUNCTION(argmin_d, reduce_loc_d_t, reduce_loc_d_min)
+REDUCE_MPI_USER_FUNCTION(argmax_i, reduce_loc_i_t, reduce_loc_i_max)
+REDUCE_MPI_USER_FUNCTION(argmin_i, reduce_loc_i_t, reduce_loc_i_min)
+REDUCE_MPI_USER_FUNCTION(welford, reduce_stats_t, reduce_stats_merge)
+
+/**
+ * Builds an MPI struct type for a C struct of two members, resized to the
+ * size of the C struct so arrays of them work.
+ */
+static void reduce_mpi_pair_type(MPI_Datatype first, MPI_Aint first_offset,
+                                 MPI_Datatype second, MPI_Aint second_offset,
+                                 MPI_Aint extent, MPI_Datatype* type) {
+  int lengths[2] = { 1, 1 };
+  MPI_Aint offsets[2] = { first_offset, second_offset };
+  MPI_Datatype types[2] = { first, second };
+  MPI_Datatype tmp;
+
+  MPI_Type_create_struct(2, lengths, offsets, types, &tmp);
+  MPI_Type_create_resized(tmp, 0, extent, type);
+  MPI_Type_commit(type);
+  MPI_Type_free(&tmp);
+}
+
+/**
+ * Creates the datatypes and operations. Call it once, after MPI_Init.
+ */
+static void reduce_mpi_init(void) {
+  int lengths[2] = { 1, 2 };
+  MPI_Aint offsets[2] = { offsetof(reduce_stats_t, n),
+                          offsetof(reduce_stats_t, mean) };
+  MPI_Datatype types[2] = { MPI_LONG, MPI_DOUBLE };
+  MPI_Datatype tmp;
+
+  reduce_mpi_pair_type(MPI_DOUBLE, offsetof(reduce_loc_d_t, value), MPI_LONG,
+                       offsetof(reduce_loc_d_t, index), sizeof(reduce_loc_d_t),
+                       &reduce_mpi_loc_d_type);
+  reduce_mpi_pair_type(MPI_INT, offsetof(reduce_loc_i_t, value), MPI_LONG,
+                       offsetof(reduce_loc_i_t, index), sizeof(reduce_loc_i_t),
+                       &reduce_mpi_loc_i_type);
+
+  // mean and m2 are contiguous.
+  MPI_Type_create_struct(2, lengths, offsets, types, &tmp);
+  MPI_Type_create_resized(tmp, 0, sizeof(reduce_stats_t),
+                          &reduce_mpi_stats_type);
+  MPI_Type_commit(&reduce_mpi_stats_type);
+  MPI_Type_free(&tmp);
+
+  // Ties are broken by index, so argmax/argmin are commutative. Merging
+  // stats is commutative up to rounding.
+  MPI_Op_create(reduce_mpi_combine_argmax_d, 1, &reduce_mpi_argmax_d_op);
+  MPI_Op_create(reduce_mpi_combine_argmin_d, 1, &reduce_mpi_argmin_d_op);
+  MPI_Op_create(reduce_mpi_combine_argmax_i, 1, &reduce_mpi_argmax_i_op);
+  MPI_Op_create(reduce_mpi_combine_argmin_i, 1, &reduce_mpi_argmin_i_op);
+  MPI_Op_create(reduce_mpi_combine_welford, 1, &reduce_mpi_welford_op);
+}
+
+/**
+ * Frees what reduce_mpi_init() created. Call it before MPI_Finalize.
+ */
+static void reduce_mpi_free(void) {
+  MPI_Op_free(&reduce_mpi_argmax_d_op);
+  MPI_Op_free(&reduce_mpi_argmin_d_op);
+  MPI_Op_free(&reduce_mpi_argmax_i_op);
+  MPI_Op_free(&reduce_mpi_argmin_i_op);
+  MPI_Op_free(&reduce_mpi_welford_op);
+  MPI_Type_free(&reduce_mpi_loc_d_type);
+  MPI_Type_free(&reduce_mpi_loc_i_type);
+  MPI_Type_free(&reduce_mpi_stats_type);
+}
+
+static inline reduce_loc_d_t reduce_mpi_argmax_d(reduce_loc_d_t local,
+                                                 MPI_Comm comm) {
+  reduce_loc_d_t global;
+  MPI_Allreduce(&local, &global, 1, reduce_mpi_loc_d_type,
+                reduce_mpi_argmax_d_op, comm);
+  return global;
+}
+
+static inline reduce_loc_d_t reduce_mpi_argmin_d(reduce_loc_d_t local,
+                                                 MPI_Comm comm) {
+  reduce_loc_d_t global;
+  MPI_Allreduce(&local, &global, 1, reduce_mpi_loc_d_type,
+                reduce_mpi_argmin_d_op, comm);
+  return global;
+}
+
+static inline reduce_loc_i_t reduce_mpi_argmax_i(reduce_loc_i_t local,
+                                                 MPI_Comm comm) {
+  reduce_loc_i_t global;
+  MPI_Allreduce(&local, &global, 1, reduce_mpi_loc_i_type,
+                reduce_mpi_argmax_i_op, comm);
+  return global;
+}
+
+static inline reduce_loc_i_t reduce_mpi_argmin_i(reduce_loc_i_t local,
+                                                 MPI_Comm comm) {
+  reduce_loc_i_t global;
+  MPI_Allreduce(&local, &global, 1, reduce_mpi_loc_i_type,
+                reduce_mpi_argmin_i_op, comm);
+  return global;
+}
+
+static inline reduce_stats_t reduce_mpi_stats(reduce_stats_t local,
+                                              MPI_Comm comm) {
+  reduce_stats_t global;
+  MPI_Allreduce(&local, &global, 1, reduce_mpi_stats_type,
+                reduce_mpi_welford_op, comm);
+  return global;
+}
+
+#endif  // REDUCE_MPI_H
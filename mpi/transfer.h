@@ -0,0 +1,178 @@
+/**
+ * Row and block transfers with persistent requests and derived datatypes.
+ *
+ * a09_e02_matrix_sum.c and a10_e03_matrix_multiplication.c send a matrix one
+ * row at a time, with a new MPI_Bsend / MPI_Isend (and a new request) for
+ * every row, and can only send contiguous rows. When the same rows are sent
+ * over and over (every iteration of a solver, every frame...), MPI has to
+ * check the arguments, look up the peer and set up the request each time,
+ * which is a large part of the cost of a small message.
+ *
+ * A transfer_t sets up, once, one persistent request (MPI_Send_init or
+ * MPI_Recv_init) for each of `nblocks` blocks of a matrix. Block b starts
+ * `stride` bytes after block b - 1, is described by one element of a
+ * datatype, and is sent with tag `tag + b`. Every round then only costs an
+ * MPI_Startall (or MPI_Start per block) and a wait:
+ *
+ *   MPI_Datatype row;
+ *   transfer_t t;
+ *   transfer_row_type(cols, MPI_FLOAT, &row);
+ *   transfer_send_init(&t, m, rows, cols * sizeof(float), row, 0, 0, comm);
+ *   for (int it = 0; it < iterations; ++it) {
+ *     ...                       // Update m.
+ *     transfer_start(&t);
+ *     transfer_wait(&t);
+ *   }
+ *   transfer_free(&t);
+ *   MPI_Type_free(&row);
+ *
+ * The datatypes make non-contiguous blocks travel without copying them into
+ * a buffer first:
+ *
+ * - transfer_row_type:          `cols` contiguous elements (a row).
+ * - transfer_column_block_type: `width` columns of all the rows of a row-major
+ *                               matrix (MPI_Type_vector); consecutive column
+ *                               blocks are `width * sizeof(element)` apart.
+ * - transfer_tile_type:         a tile at any position of a row-major matrix
+ *                               (MPI_Type_create_subarray). The position is in
+ *                               the type, so pass the matrix itself as base.
+ *
+ * The sender and the receiver may use different datatypes, as long as they
+ * have the same number of elements (e.g. a column block received into a
+ * contiguous buffer).
+ */
+
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <assert.h>
+#include <mpi.h>
+#include <stdio.h>    /* fprintf */
+#include <stdlib.h>   /* malloc, free */
+
+typedef struct {
+  int nblocks;
+  MPI_Request* requests;   // One persistent request per block.
+} transfer_t;
+
+/**
+ * Creates (and commits) the type of one row of `cols` elements.
+ */
+static inline void transfer_row_type(int cols, MPI_Datatype type,
+                                     MPI_Datatype* row) {
+  MPI_Type_contiguous(cols, type, row);
+  MPI_Type_commit(row);
+}
+
+/**
+ * Creates (and commits) the type of a `rows` x `width` block of columns of a
+ * row-major matrix with `ld` elements per row.
+ */
+static inline void transfer_column_block_type(int rows, int width, int ld,
+                                              MPI_Datatype type,
+                                              MPI_Datatype* block) {
+  MPI_Type_vector(rows, width, ld, type, block);
+  MPI_Type_commit(block);
+}
+
+/**
+ * Creates (and commits) the type of the `tile_rows` x `tile_cols` tile at
+ * (row0, col0) of a `rows` x `cols` row-major matrix.
+ */
+static inline void transfer_tile_type(int rows, int cols, int tile_rows,
+                                      int tile_cols, int row0, int col0,
+                                      MPI_Datatype type, MPI_Datatype* tile) {
+  int sizes[2] = { rows, cols };
+  int subsizes[2] = { tile_rows, tile_cols };
+  int starts[2] = { row0, col0 };
+  MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, type,
+                           tile);
+  MPI_Type_commit(tile);
+}
+
+/**
+ * Sets up the persistent sends (`send` != 0) or receives of blocks
+ * 0 .. nblocks - 1 to or from `peer`. Nothing is transferred until
+ * transfer_start(). The datatype can be freed afterwards.
+ */
+static inline void transfer_init(transfer_t* t, int send, void* base,
+                                 int nblocks, MPI_Aint stride,
+                                 MPI_Datatype block, int peer, int tag,
+                                 MPI_Comm comm) {
+  int* tag_ub;
+  int found;
+
+  // Every block takes one tag, so tag + nblocks - 1 must not exceed the tag
+  // upper bound. MPI only guarantees MPI_TAG_UB >= 32767; check the real one.
+  MPI_Comm_get_attr(comm, MPI_TAG_UB, &tag_ub, &found);
+  if (found && (long)tag + nblocks - 1 > *tag_ub) {
+    fprintf(stderr, "transfer_init: tags %d .. %d exceed MPI_TAG_UB (%d)\n",
+            tag, tag + nblocks - 1, *tag_ub);
+    MPI_Abort(comm, 1);
+  }
+
+  t->nblocks = nblocks;
+  t->requests = (MPI_Request*)malloc(sizeof(MPI_Request) * nblocks);
+  assert(t->requests != NULL);
+
+  for (int b = 0; b < nblocks; ++b) {
+    char* p = (char*)base + b * stride;
+    if (send) {
+      MPI_Send_init(p, 1, block, peer, tag + b, comm, &t->requests[b]);
+    }
+    else {
+      MPI_Recv_init(p, 1, block, peer, tag + b, comm, &t->requests[b]);
+    }
+  }
+}
+
+static inline void transfer_send_init(transfer_t* t, const void* base,
+                                      int nblocks, MPI_Aint stride,
+                                      MPI_Datatype block, int dest, int tag,
+                                      MPI_Comm comm) {
+  transfer_init(t, 1, (void*)base, nblocks, stride, block, dest, tag, comm);
+}
+
+static inline void transfer_recv_init(transfer_t* t, void* base, int nblocks,
+                                      MPI_Aint stride, MPI_Datatype block,
+                                      int source, int tag, MPI_Comm comm) {
+  transfer_init(t, 0, base, nblocks, stride, block, source, tag, comm);
+}
+
+/**
+ * Starts the transfer of every block.
+ */
+static inline void transfer_start(transfer_t* t) {
+  MPI_Startall(t->nblocks, t->requests);
+}
+
+/**
+ * Starts the transfer of block b only (e.g. as soon as it is computed).
+ */
+static inline void transfer_start_block(transfer_t* t, int b) {
+  MPI_Start(&t->requests[b]);
+}
+
+/**
+ * Waits for every started block. The requests stay allocated, ready for the
+ * next transfer_start().
+ */
+static inline void transfer_wait(transfer_t* t) {
+  MPI_Waitall(t->nblocks, t->requests, MPI_STATUSES_IGNORE);
+}
+
+static inline void transfer_wait_block(transfer_t* t, int b) {
+  MPI_Wait(&t->requests[b], MPI_STATUS_IGNORE);
+}
+
+/**
+ * Frees the persistent requests. No block may be in flight.
+ */
+static inline void transfer_free(transfer_t* t) {
+  for (int b = 0; b < t->nblocks; ++b) MPI_Request_free(&t->requests[b]);
+  free(t->requests);
+  t->requests = NULL;
+  t->nblocks = 0;
+}
+
+#endif  // TRANSFER_H
@@ -0,0 +1,273 @@
+/**
+ * Message rate of the per-row sends of the matrix examples against the
+ * persistent requests and derived datatypes of transfer.h.
+ *
+ * Rank 0 sends a ROWS x cols matrix of floats to rank 1, `iterations` times,
+ * for cols = 8, 32, ... MAX_COLS. Every iteration ends with an empty
+ * acknowledgement from rank 1, so rank 0 never runs more than one matrix
+ * ahead. The variants:
+ *
+ * - rows_isend:        one MPI_Isend / MPI_Irecv per row, with new requests
+ *                      every time, as in a10_e03_matrix_multiplication.c.
+ * - rows_persistent:   one persistent request per row (transfer_row_type),
+ *                      set up once and restarted with MPI_Startall.
+ * - columns_pack:      NBLOCKS blocks of columns, copied into a contiguous
+ *                      buffer by the sender and out of it by the receiver.
+ * - columns_vector:    the same blocks sent in place, with persistent requests
+ *                      on a transfer_column_block_type.
+ * - tiles_subarray:    the matrix as TILE_GRID_ROWS x TILE_GRID_COLS tiles,
+ *                      sent in place with one persistent request per tile on
+ *                      a transfer_tile_type. The tile's position is in the
+ *                      type, so every one uses the matrix itself as base.
+ *
+ * Any ranks above 1 exit right away. The received matrix is checked after the
+ * last iteration of every variant.
+ *
+ * Compile & run:
+ * $ mpicc -O2 -o transfer_bench transfer_bench.c
+ * $ mpiexec -n 2 ./transfer_bench [max_cols]
+ */
+
+#include <assert.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atoi */
+#include <string.h>   /* memcpy */
+
+#include "transfer.h"
+
+#define ROWS      256
+#define MAX_COLS  8192
+#define NBLOCKS   8           // Column blocks per matrix.
+#define TILE_GRID_ROWS 2      // Tiles per matrix: TILE_GRID_ROWS x
+#define TILE_GRID_COLS 4      // TILE_GRID_COLS, NBLOCKS in all.
+#define VOLUME    (1L << 26)  // Bytes sent per variant and size, roughly.
+#define MIN_ITERS 20
+#define MAX_ITERS 2000
+#define ACK_TAG   32000
+
+_Static_assert(TILE_GRID_ROWS * TILE_GRID_COLS == NBLOCKS,
+               "the tile grid must have NBLOCKS tiles");
+
+enum {
+  ROWS_ISEND, ROWS_PERSISTENT, COLUMNS_PACK, COLUMNS_VECTOR, TILES_SUBARRAY,
+  VARIANTS
+};
+
+const char* variant_names[VARIANTS] = {
+  "rows_isend", "rows_persistent", "columns_pack", "columns_vector",
+  "tiles_subarray"
+};
+
+/**
+ * Sets the matrix sent in iteration `it`.
+ */
+void fill(float* m, int cols, int it) {
+  for (long i = 0; i < (long)ROWS * cols; ++i) m[i] = (float)(i + it);
+}
+
+int check(const float* m, int cols, int it) {
+  for (long i = 0; i < (long)ROWS * cols; ++i) {
+    if (m[i] != (float)(i + it)) return 0;
+  }
+  return 1;
+}
+
+/**
+ * Copies column block b into / out of a contiguous buffer.
+ */
+void pack_block(const float* m, int cols, int b, float* buf) {
+  int width = cols / NBLOCKS;
+  for (int i = 0; i < ROWS; ++i) {
+    memcpy(&buf[i * width], &m[i * cols + b * width], sizeof(float) * width);
+  }
+}
+
+void unpack_block(float* m, int cols, int b, const float* buf) {
+  int width = cols / NBLOCKS;
+  for (int i = 0; i < ROWS; ++i) {
+    memcpy(&m[i * cols + b * width], &buf[i * width], sizeof(float) * width);
+  }
+}
+
+/**
+ * Runs one variant on rank 0 (sender) or 1 (receiver). Returns the time, on
+ * rank 0, and whether the data arrived intact, on rank 1.
+ */
+double run(int variant, int my_rank, float* m, float* buf, int cols,
+           int iterations, int* correct, MPI_Comm comm) {
+  int width = cols / NBLOCKS;
+  int nmessages = (variant <= ROWS_PERSISTENT) ? ROWS : NBLOCKS;
+  int peer = 1 - my_rank;
+  MPI_Request* requests =
+    (MPI_Request*)malloc(sizeof(MPI_Request) * nmessages);
+  MPI_Datatype types[NBLOCKS];
+  transfer_t t[NBLOCKS];
+  int ntransfers = 0;
+  assert(requests != NULL);
+
+  // Setup, not timed: that's the point of persistent requests.
+  if (variant == ROWS_PERSISTENT || variant == COLUMNS_VECTOR) {
+    MPI_Aint stride = sizeof(float) * (variant == ROWS_PERSISTENT ? cols
+                                                                  : width);
+    if (variant == ROWS_PERSISTENT) {
+      transfer_row_type(cols, MPI_FLOAT, &types[0]);
+    }
+    else {
+      transfer_column_block_type(ROWS, width, cols, MPI_FLOAT, &types[0]);
+    }
+    transfer_init(&t[0], my_rank == 0, m, nmessages, stride, types[0], peer,
+                  0, comm);
+    ntransfers = 1;
+  }
+  else if (variant == TILES_SUBARRAY) {
+    int tile_rows = ROWS / TILE_GRID_ROWS, tile_cols = cols / TILE_GRID_COLS;
+    for (int b = 0; b < NBLOCKS; ++b) {
+      transfer_tile_type(ROWS, cols, tile_rows, tile_cols,
+                         (b / TILE_GRID_COLS) * tile_rows,
+                         (b % TILE_GRID_COLS) * tile_cols, MPI_FLOAT,
+                         &types[b]);
+      transfer_init(&t[b], my_rank == 0, m, 1, 0, types[b], peer, b, comm);
+    }
+    ntransfers = NBLOCKS;
+  }
+
+  MPI_Barrier(comm);
+  double elapsed = -MPI_Wtime();
+
+  for (int it = 0; it < iterations; ++it) {
+    if (my_rank == 0) fill(m, cols, it);
+
+    switch (variant) {
+      case ROWS_ISEND:
+        for (int i = 0; i < ROWS; ++i) {
+          if (my_rank == 0) {
+            MPI_Isend(&m[i * cols], cols, MPI_FLOAT, peer, i, comm,
+                      &requests[i]);
+          }
+          else {
+            MPI_Irecv(&m[i * cols], cols, MPI_FLOAT, peer, i, comm,
+                      &requests[i]);
+          }
+        }
+        MPI_Waitall(ROWS, requests, MPI_STATUSES_IGNORE);
+        break;
+
+      case COLUMNS_PACK:
+        for (int b = 0; b < NBLOCKS; ++b) {
+          float* piece = &buf[b * ROWS * width];
+          if (my_rank == 0) {
+            pack_block(m, cols, b, piece);
+            MPI_Isend(piece, ROWS * width, MPI_FLOAT, peer, b, comm,
+                      &requests[b]);
+          }
+          else {
+            MPI_Irecv(piece, ROWS * width, MPI_FLOAT, peer, b, comm,
+                      &requests[b]);
+          }
+        }
+        MPI_Waitall(NBLOCKS, requests, MPI_STATUSES_IGNORE);
+        if (my_rank == 1) {
+          for (int b = 0; b < NBLOCKS; ++b) {
+            unpack_block(m, cols, b, &buf[b * ROWS * width]);
+          }
+        }
+        break;
+
+      default:
+        for (int k = 0; k < ntransfers; ++k) transfer_start(&t[k]);
+        for (int k = 0; k < ntransfers; ++k) transfer_wait(&t[k]);
+    }
+
+    // Acknowledge the whole matrix.
+    if (my_rank == 0) {
+      MPI_Recv(NULL, 0, MPI_BYTE, peer, ACK_TAG, comm, MPI_STATUS_IGNORE);
+    }
+    else {
+      MPI_Send(NULL, 0, MPI_BYTE, peer, ACK_TAG, comm);
+    }
+  }
+
+  elapsed += MPI_Wtime();
+
+  if (my_rank == 1) *correct = check(m, cols, iterations - 1);
+
+  for (int k = 0; k < ntransfers; ++k) {
+    transfer_free(&t[k]);
+    MPI_Type_free(&types[k]);
+  }
+  free(requests);
+  return elapsed;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+
+  // Initialize MPI.
+  MPI_Init(NULL, NULL);
+
+  int world_size, my_rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+
+  int max_cols = MAX_COLS;
+  if (argc > 1) max_cols = atoi(argv[1]);
+
+  if (world_size < 2) {
+    fprintf(stderr, "This program needs at least 2 processes to run.\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  // Ranks 0 and 1 only; the others have nothing to do.
+  MPI_Comm comm;
+  MPI_Comm_split(MPI_COMM_WORLD, my_rank < 2 ? 0 : MPI_UNDEFINED, my_rank,
+                 &comm);
+  if (comm == MPI_COMM_NULL) {
+    MPI_Finalize();
+    return 0;
+  }
+
+  if (my_rank == 0) {
+    printf("variant,cols,message_bytes,messages,time_s,Mmsgs_per_s,"
+           "MB_per_s,correct\n");
+  }
+
+  for (int cols = NBLOCKS; cols <= max_cols; cols *= 4) {
+    float* m = (float*)malloc(sizeof(float) * ROWS * cols);
+    float* buf = (float*)malloc(sizeof(float) * ROWS * cols);
+    assert(m != NULL && buf != NULL);
+
+    long bytes = sizeof(float) * ROWS * (long)cols;
+    int iterations = (int)(VOLUME / bytes);
+    if (iterations < MIN_ITERS) iterations = MIN_ITERS;
+    if (iterations > MAX_ITERS) iterations = MAX_ITERS;
+
+    for (int v = 0; v < VARIANTS; ++v) {
+      int correct = 0;
+      double t = run(v, my_rank, m, buf, cols, iterations, &correct, comm);
+
+      // The result is known on rank 1, the time on rank 0.
+      if (my_rank == 1) {
+        MPI_Send(&correct, 1, MPI_INT, 0, 0, comm);
+      }
+      else {
+        MPI_Recv(&correct, 1, MPI_INT, 1, 0, comm, MPI_STATUS_IGNORE);
+
+        int per_matrix = (v <= ROWS_PERSISTENT) ? ROWS : NBLOCKS;
+        long messages = (long)per_matrix * iterations;
+        printf("%s,%d,%ld,%ld,%.5f,%.3f,%.1f,%s\n", variant_names[v], cols,
+               bytes / per_matrix, messages, t, messages / t * 1e-6,
+               bytes * iterations / t * 1e-6, correct ? "yes" : "NO");
+      }
+    }
+
+    free(m);
+    free(buf);
+  }
+
+  MPI_Comm_free(&comm);
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * pi and histogram throughput under each thread binding.
+ *
+ * The OpenMP runtime reads OMP_PROC_BIND and OMP_PLACES only at startup, so
+ * for every configuration below this program re-runs itself in a child
+ * process with omp_affinity.h's affinity_exec(). Each child prints its
+ * settings and thread-to-CPU map (lines starting with #), and then one CSV
+ * line per kernel:
+ *
+ * - pi:        pi_omp_v3_reduction.c's loop, reported in Msteps/s.
+ * - histogram: histogram.h's HIST_PRIVATE over uniform samples, reported in
+ *              Msamples/s.
+ *
+ * Every kernel runs `reps` times. Besides the median, the spread
+ * (max - min) / median shows how much the binding reduces the run-to-run
+ * variance.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o affinity_bench affinity_bench.c -lm
+ * OMP_NUM_THREADS=16 ./affinity_bench [num_steps] [nvals] [reps]
+ *
+ * A single configuration, with whatever binding is in the environment:
+ * OMP_PROC_BIND=spread OMP_PLACES=cores ./affinity_bench child
+ */
+
+#define _GNU_SOURCE   // sched_getcpu, for omp_affinity.h. Before any #include.
+
+#include <assert.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, qsort, atol, atoi */
+#include <string.h>   /* strcmp */
+
+#include "histogram.h"
+#include "omp_affinity.h"
+#include "parallel_rng.h"
+
+#define NUM_STEPS 200000000L
+#define NVALS     20000000L
+#define NBUCKETS  1000
+#define REPS      7
+#define SEED      12345
+
+const affinity_config_t configs[] = {
+  { NULL, NULL },              // Whatever the runtime does by default.
+  { "false", NULL },           // Explicitly unbound.
+  { "close", "threads" },
+  { "spread", "threads" },
+  { "close", "cores" },
+  { "spread", "cores" },
+  { "close", "sockets" },
+  { "spread", "sockets" },
+};
+
+double pi_reduction(long num_steps) {
+  double step = 1.0 / (double)num_steps;
+  double sum = 0.0;
+  long i;
+
+  #pragma omp parallel for reduction(+:sum)
+  for (i = 0; i < num_steps; ++i) {
+    double x = (i + 0.5) * step;
+    sum += 4.0 / (1.0 + x * x);
+  }
+
+  return step * sum;
+}
+
+int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+void report(const char* kernel, double* times, int reps, double items) {
+  const char* bind = getenv("OMP_PROC_BIND");
+  const char* places = getenv("OMP_PLACES");
+  double median;
+
+  qsort(times, reps, sizeof(double), compare_doubles);
+  median = times[reps / 2];
+
+  printf("%s,%s,%s,%d,%.5f,%.5f,%.5f,%.1f,%.1f\n", bind ? bind : "default",
+         places ? places : "default", kernel, omp_get_max_threads(), median,
+         times[0], times[reps - 1],
+         100.0 * (times[reps - 1] - times[0]) / median, items / median * 1e-6);
+}
+
+/**
+ * Runs both kernels with the binding this process was started with.
+ */
+void run_child(long num_steps, long nvals, int reps) {
+  int* samples = (int*)malloc(sizeof(int) * nvals);
+  int* hist = (int*)malloc(sizeof(int) * NBUCKETS);
+  double* times = (double*)malloc(sizeof(double) * reps);
+  assert(samples != NULL && hist != NULL && times != NULL);
+
+  affinity_print_settings(stdout);
+  affinity_print_thread_map(stdout);
+
+  // Generated in parallel, so the pages are placed by first touch under the
+  // same binding that then reads them.
+  rng_fill_ints(samples, nvals, NBUCKETS, SEED);
+
+  // Warm-up.
+  pi_reduction(num_steps / 10);
+
+  for (int r = 0; r < reps; ++r) {
+    double start = omp_get_wtime();
+    volatile double pi = pi_reduction(num_steps);
+    times[r] = omp_get_wtime() - start;
+    (void)pi;
+  }
+  report("pi", times, reps, (double)num_steps);
+
+  for (int r = 0; r < reps; ++r) {
+    double start = omp_get_wtime();
+    histogram_fill(samples, nvals, hist, NBUCKETS, HIST_PRIVATE);
+    times[r] = omp_get_wtime() - start;
+  }
+  report("histogram", times, reps, (double)nvals);
+
+  free(samples);
+  free(hist);
+  free(times);
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  int child = (argc > 1 && strcmp(argv[1], "child") == 0);
+  int first = child ? 2 : 1;
+  long num_steps = NUM_STEPS;
+  long nvals = NVALS;
+  int reps = REPS;
+
+  if (argc > first) num_steps = atol(argv[first]);
+  if (argc > first + 1) nvals = atol(argv[first + 1]);
+  if (argc > first + 2) reps = atoi(argv[first + 2]);
+
+  if (child) {
+    run_child(num_steps, nvals, reps);
+    return 0;
+  }
+
+  char steps_arg[32], nvals_arg[32], reps_arg[32];
+  char* child_argv[] = { argv[0], "child", steps_arg, nvals_arg, reps_arg,
+                         NULL };
+  snprintf(steps_arg, sizeof(steps_arg), "%ld", num_steps);
+  snprintf(nvals_arg, sizeof(nvals_arg), "%ld", nvals);
+  snprintf(reps_arg, sizeof(reps_arg), "%d", reps);
+
+  printf("proc_bind,places,kernel,threads,median_s,min_s,max_s,spread_pct,"
+         "Mitems_per_s\n");
+
+  for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); ++c) {
+    if (affinity_exec(&configs[c], child_argv) != 0) {
+      fprintf(stderr, "Configuration %zu failed.\n", c);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * Micro-benchmark: packed vs. padded per-thread accumulators.
+ *
+ * Every thread increments its own slot `ITERATIONS` times. In the packed
+ * layout the slots are consecutive doubles (like `sum[NUM_THREADS]` in
+ * pi_omp_v1_false_sharing.c), so up to CACHE_LINE_SIZE / 8 threads share a
+ * cache line. In the padded layout each slot is a padded_double_t from
+ * padded_accumulator.h. The threads never touch each other's data, so any
+ * difference in throughput is caused by false sharing alone.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o false_sharing_bench false_sharing_bench.c
+ * ./false_sharing_bench [max_threads]
+ */
+
+#include <assert.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atoi */
+
+#include "padded_accumulator.h"
+
+#define ITERATIONS 50000000L
+
+/**
+ * Each thread adds 1.0 to packed[id] ITERATIONS times.
+ * @return Elapsed time in seconds.
+ */
+double run_packed(int nthreads) {
+  double* packed = (double*)malloc(sizeof(double) * nthreads);
+  double elapsed = 0.0;
+  assert(packed != NULL);
+
+  elapsed -= omp_get_wtime();
+  #pragma omp parallel num_threads(nthreads)
+  {
+    // volatile forces a load and a store per iteration, like a real
+    // accumulator that lives in memory.
+    volatile double* slot = &packed[omp_get_thread_num()];
+    *slot = 0.0;
+    for (long i = 0; i < ITERATIONS; ++i) {
+      *slot += 1.0;
+    }
+  }
+  elapsed += omp_get_wtime();
+
+  free(packed);
+  return elapsed;
+}
+
+/**
+ * Same as run_packed(), but with one cache line per thread.
+ * @return Elapsed time in seconds.
+ */
+double run_padded(int nthreads) {
+  padded_double_t* padded = padded_double_alloc(nthreads);
+  double elapsed = 0.0;
+  assert(padded != NULL);
+
+  elapsed -= omp_get_wtime();
+  #pragma omp parallel num_threads(nthreads)
+  {
+    volatile double* slot = &padded[omp_get_thread_num()].value;
+    for (long i = 0; i < ITERATIONS; ++i) {
+      *slot += 1.0;
+    }
+  }
+  elapsed += omp_get_wtime();
+
+  padded_free(padded);
+  return elapsed;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  int max_threads = omp_get_num_procs();
+  if (argc > 1) max_threads = atoi(argv[1]);
+
+  if (max_threads <= 0) {
+    fprintf(stderr, "Usage: %s [max_threads]\n", argv[0]);
+    return 1;
+  }
+
+  omp_set_dynamic(0);
+
+  printf("cache line size: %d bytes, %ld increments per thread\n",
+         CACHE_LINE_SIZE, ITERATIONS);
+  printf("threads,packed_s,padded_s,packed_Mops,padded_Mops,padded_speedup\n");
+
+  // Thread sweep: powers of two, plus max_threads itself.
+  for (int t = 1; ; t *= 2) {
+    if (t > max_threads) t = max_threads;
+
+    double t_packed = run_packed(t);
+    double t_padded = run_padded(t);
+    double ops = (double)ITERATIONS * t * 1e-6;
+
+    printf("%d,%.4f,%.4f,%.1f,%.1f,%.2f\n", t, t_packed, t_padded,
+           ops / t_packed, ops / t_padded, t_packed / t_padded);
+
+    if (t == max_threads) break;
+  }
+
+  return 0;
+}
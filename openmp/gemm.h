@@ -0,0 +1,340 @@
+/**
+ * Single-precision matrix multiplication, C += A * B, blocked for the caches
+ * and vectorized.
+ *
+ * The textbook i-j-k loop (task_ABX in ../mpi/a10_e03_matrix_multiplication.c)
+ * reads B column by column, one cache line per multiply-add, so for large
+ * matrices it runs at the speed of memory. This kernel follows the structure
+ * of BLIS / GotoBLAS:
+ *
+ *   for jc in steps of NC:            columns of C and B
+ *     for pc in steps of KC:          the shared dimension
+ *       pack B[pc:pc+KC, jc:jc+NC]    into slivers NR wide   (stays in L3)
+ *       for ic in steps of MC:        rows of C and A; one block per thread
+ *         pack A[ic:ic+MC, pc:pc+KC]  into panels MR tall    (stays in L2)
+ *         for jr in steps of NR:
+ *           for ir in steps of MR:
+ *             micro-kernel: C[ir:ir+MR, jr:jr+NR] += panel * sliver
+ *
+ * The micro-kernel keeps the MR x NR tile of C in vector registers for all KC
+ * steps, and both operands are read sequentially from the packed buffers, so
+ * every element loaded from memory is used MR (or NR) times. Packing also
+ * zero-pads the edges, so any m, n and k work.
+ *
+ * There are three micro-kernels; the fastest one the CPU supports is picked
+ * at run time with __builtin_cpu_supports, as in pi_omp_v4_simd.c:
+ *
+ * - generic: 4 x 8, plain C with `omp simd`.
+ * - avx2:    6 x 16, AVX2 + FMA, 12 accumulator registers.
+ * - avx512:  12 x 32, AVX-512, 24 accumulator registers.
+ *
+ * The rows blocks (ic loop) are split among the OpenMP threads, and all the
+ * threads pack the shared B panel together.
+ *
+ * Usage (row-major, with leading dimensions):
+ *
+ *   gemm_sgemm(m, n, k, A, lda, B, ldb, C, ldc);   // C += A * B
+ *
+ * Zero C first to get C = A * B. Call it from outside a parallel region.
+ */
+
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <assert.h>
+#include <omp.h>
+#include <stdlib.h>   /* aligned_alloc, free */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GEMM_X86_DISPATCH 1
+#else
+#define GEMM_X86_DISPATCH 0
+#endif
+
+// Block sizes, in elements. MC must be a multiple of every kernel's MR, and
+// NC of every kernel's NR.
+#ifndef GEMM_MC
+#define GEMM_MC 144
+#endif
+#ifndef GEMM_KC
+#define GEMM_KC 256
+#endif
+#ifndef GEMM_NC
+#define GEMM_NC 2048
+#endif
+
+// Largest MR x NR tile of any kernel.
+#define GEMM_MAX_TILE (12 * 32)
+
+/* c[0:mr, 0:nr] += a * b, with a and b packed for kc steps. */
+typedef void (*gemm_micro_t)(int kc, const float* a, const float* b, float* c,
+                             int ldc, int mr, int nr);
+
+typedef struct {
+  const char* name;
+  int mr;
+  int nr;
+  gemm_micro_t kernel;
+} gemm_kernel_t;
+
+/**
+ * Adds the first mr x nr elements of a full tile to C.
+ */
+static inline void gemm_add_tile(const float* tile, int tile_nr, float* c,
+                                 int ldc, int mr, int nr) {
+  for (int r = 0; r < mr; ++r) {
+    for (int j = 0; j < nr; ++j) {
+      c[r * ldc + j] += tile[r * tile_nr + j];
+    }
+  }
+}
+
+static void gemm_micro_generic(int kc, const float* a, const float* b,
+                               float* c, int ldc, int mr, int nr) {
+  float acc[4][8] = { { 0.0f } };
+
+  for (int p = 0; p < kc; ++p) {
+    #pragma GCC unroll 4
+    for (int r = 0; r < 4; ++r) {
+      float ar = a[p * 4 + r];
+      #pragma omp simd
+      for (int j = 0; j < 8; ++j) {
+        acc[r][j] += ar * b[p * 8 + j];
+      }
+    }
+  }
+
+  gemm_add_tile(&acc[0][0], 8, c, ldc, mr, nr);
+}
+
+#if GEMM_X86_DISPATCH
+
+__attribute__((target("avx2,fma")))
+static void gemm_micro_avx2(int kc, const float* a, const float* b, float* c,
+                            int ldc, int mr, int nr) {
+  __m256 acc[6][2];
+
+  #pragma GCC unroll 6
+  for (int r = 0; r < 6; ++r) {
+    acc[r][0] = _mm256_setzero_ps();
+    acc[r][1] = _mm256_setzero_ps();
+  }
+
+  for (int p = 0; p < kc; ++p) {
+    __m256 b0 = _mm256_loadu_ps(b);
+    __m256 b1 = _mm256_loadu_ps(b + 8);
+
+    #pragma GCC unroll 6
+    for (int r = 0; r < 6; ++r) {
+      __m256 ar = _mm256_broadcast_ss(a + r);
+      acc[r][0] = _mm256_fmadd_ps(ar, b0, acc[r][0]);
+      acc[r][1] = _mm256_fmadd_ps(ar, b1, acc[r][1]);
+    }
+    a += 6;
+    b += 16;
+  }
+
+  if (mr == 6 && nr == 16) {
+    #pragma GCC unroll 6
+    for (int r = 0; r < 6; ++r) {
+      float* row = c + r * ldc;
+      _mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), acc[r][0]));
+      _mm256_storeu_ps(row + 8,
+                       _mm256_add_ps(_mm256_loadu_ps(row + 8), acc[r][1]));
+    }
+  }
+  else {
+    float tile[6 * 16];
+    // Unrolled like the others, so acc[] can stay in registers.
+    #pragma GCC unroll 6
+    for (int r = 0; r < 6; ++r) {
+      _mm256_storeu_ps(tile + r * 16, acc[r][0]);
+      _mm256_storeu_ps(tile + r * 16 + 8, acc[r][1]);
+    }
+    gemm_add_tile(tile, 16, c, ldc, mr, nr);
+  }
+}
+
+__attribute__((target("avx512f")))
+static void gemm_micro_avx512(int kc, const float* a, const float* b,
+                              float* c, int ldc, int mr, int nr) {
+  __m512 acc[12][2];
+
+  #pragma GCC unroll 12
+  for (int r = 0; r < 12; ++r) {
+    acc[r][0] = _mm512_setzero_ps();
+    acc[r][1] = _mm512_setzero_ps();
+  }
+
+  for (int p = 0; p < kc; ++p) {
+    __m512 b0 = _mm512_loadu_ps(b);
+    __m512 b1 = _mm512_loadu_ps(b + 16);
+
+    #pragma GCC unroll 12
+    for (int r = 0; r < 12; ++r) {
+      __m512 ar = _mm512_set1_ps(a[r]);
+      acc[r][0] = _mm512_fmadd_ps(ar, b0, acc[r][0]);
+      acc[r][1] = _mm512_fmadd_ps(ar, b1, acc[r][1]);
+    }
+    a += 12;
+    b += 32;
+  }
+
+  if (mr == 12 && nr == 32) {
+    #pragma GCC unroll 12
+    for (int r = 0; r < 12; ++r) {
+      float* row = c + r * ldc;
+      _mm512_storeu_ps(row, _mm512_add_ps(_mm512_loadu_ps(row), acc[r][0]));
+      _mm512_storeu_ps(row + 16,
+                       _mm512_add_ps(_mm512_loadu_ps(row + 16), acc[r][1]));
+    }
+  }
+  else {
+    float tile[12 * 32];
+    #pragma GCC unroll 12
+    for (int r = 0; r < 12; ++r) {
+      _mm512_storeu_ps(tile + r * 32, acc[r][0]);
+      _mm512_storeu_ps(tile + r * 32 + 16, acc[r][1]);
+    }
+    gemm_add_tile(tile, 32, c, ldc, mr, nr);
+  }
+}
+
+#endif  // GEMM_X86_DISPATCH
+
+static const gemm_kernel_t gemm_kernel_generic = {
+  "generic", 4, 8, gemm_micro_generic
+};
+#if GEMM_X86_DISPATCH
+static const gemm_kernel_t gemm_kernel_avx2 = {
+  "avx2", 6, 16, gemm_micro_avx2
+};
+static const gemm_kernel_t gemm_kernel_avx512 = {
+  "avx512", 12, 32, gemm_micro_avx512
+};
+#endif
+
+/**
+ * The fastest kernel this CPU can run.
+ */
+static inline const gemm_kernel_t* gemm_best_kernel(void) {
+#if GEMM_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return &gemm_kernel_avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return &gemm_kernel_avx2;
+  }
+#endif
+  return &gemm_kernel_generic;
+}
+
+/**
+ * Copies A[0:mc, 0:kc] into panels of mr rows: panel i holds, for every p,
+ * the mr elements of column p. Rows past mc are zero.
+ */
+static inline void gemm_pack_a(int mc, int kc, int mr, const float* A,
+                               int lda, float* packed) {
+  for (int i = 0; i < mc; i += mr) {
+    for (int p = 0; p < kc; ++p) {
+      for (int r = 0; r < mr; ++r) {
+        *packed++ = (i + r < mc) ? A[(long)(i + r) * lda + p] : 0.0f;
+      }
+    }
+  }
+}
+
+/**
+ * Copies the sliver B[0:kc, 0:nr] (nr_valid columns of it, the rest is zero)
+ * so that, for every p, its nr elements are contiguous.
+ */
+static inline void gemm_pack_b_sliver(int kc, int nr, int nr_valid,
+                                      const float* B, int ldb, float* packed) {
+  for (int p = 0; p < kc; ++p) {
+    const float* row = B + (long)p * ldb;
+    for (int j = 0; j < nr; ++j) {
+      packed[p * nr + j] = (j < nr_valid) ? row[j] : 0.0f;
+    }
+  }
+}
+
+/**
+ * C += A * B with a given micro-kernel. See gemm_sgemm().
+ */
+static inline void gemm_sgemm_with(const gemm_kernel_t* kern, int m, int n,
+                                   int k, const float* A, int lda,
+                                   const float* B, int ldb, float* C,
+                                   int ldc) {
+  const int mr = kern->mr, nr = kern->nr;
+  int nthreads = omp_get_max_threads();
+  int mc;
+  float* b_pack;
+
+  if (m <= 0 || n <= 0 || k <= 0) return;
+
+  // Rows per block: GEMM_MC, or less if that leaves threads without work.
+  mc = (m + nthreads - 1) / nthreads;
+  mc = ((mc + mr - 1) / mr) * mr;
+  if (mc > GEMM_MC) mc = GEMM_MC;
+
+  b_pack = (float*)aligned_alloc(64, sizeof(float) * GEMM_KC * GEMM_NC);
+  assert(b_pack != NULL);
+
+  #pragma omp parallel
+  {
+    float* a_pack = (float*)aligned_alloc(64, sizeof(float) * GEMM_MC
+                                          * GEMM_KC);
+    assert(a_pack != NULL);
+
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+      int nc = (n - jc < GEMM_NC) ? n - jc : GEMM_NC;
+
+      for (int pc = 0; pc < k; pc += GEMM_KC) {
+        int kc = (k - pc < GEMM_KC) ? k - pc : GEMM_KC;
+
+        // Every thread packs some slivers of the shared B panel.
+        #pragma omp for schedule(static)
+        for (int jr = 0; jr < nc; jr += nr) {
+          int nr_valid = (nc - jr < nr) ? nc - jr : nr;
+          gemm_pack_b_sliver(kc, nr, nr_valid, B + (long)pc * ldb + jc + jr,
+                             ldb, b_pack + (long)jr * kc);
+        }
+
+        // The implicit barriers make sure B is packed before it's used, and
+        // not repacked while it's still being used.
+        #pragma omp for schedule(static)
+        for (int ic = 0; ic < m; ic += mc) {
+          int mc_cur = (m - ic < mc) ? m - ic : mc;
+          gemm_pack_a(mc_cur, kc, mr, A + (long)ic * lda + pc, lda, a_pack);
+
+          for (int jr = 0; jr < nc; jr += nr) {
+            int nr_cur = (nc - jr < nr) ? nc - jr : nr;
+            const float* b_sliver = b_pack + (long)jr * kc;
+
+            for (int ir = 0; ir < mc_cur; ir += mr) {
+              int mr_cur = (mc_cur - ir < mr) ? mc_cur - ir : mr;
+              kern->kernel(kc, a_pack + (long)ir * kc, b_sliver,
+                           C + (long)(ic + ir) * ldc + jc + jr, ldc, mr_cur,
+                           nr_cur);
+            }
+          }
+        }
+      }
+    }
+
+    free(a_pack);
+  }
+
+  free(b_pack);
+}
+
+/**
+ * C += A * B, where A is m x k, B is k x n and C is m x n, all row-major
+ * with leading dimensions lda, ldb and ldc (the distance between rows).
+ */
+static inline void gemm_sgemm(int m, int n, int k, const float* A, int lda,
+                              const float* B, int ldb, float* C, int ldc) {
+  gemm_sgemm_with(gemm_best_kernel(), m, n, k, A, lda, B, ldb, C, ldc);
+}
+
+#endif  // GEMM_H
@@ -0,0 +1,181 @@
+/**
+ * GFLOP/s of the matrix multiplication kernels in gemm.h.
+ *
+ * For square matrices of size 256, 512, ... up to max_n, runs:
+ *
+ * - naive:   the i-j-k loop of task_ABX in
+ *            ../mpi/a10_e03_matrix_multiplication.c, in parallel over i. It
+ *            reads B by columns. Only up to NAIVE_MAX_N, it is too slow after.
+ * - ikj:     the same loop with k and j swapped, so B is read by rows and the
+ *            inner loop vectorizes; no blocking.
+ * - generic, avx2, avx512: gemm_sgemm_with() with each micro-kernel the CPU
+ *            supports.
+ *
+ * An n x n multiplication takes 2 n^3 floating-point operations. Every result
+ * is checked on SAMPLES random entries against a dot product in double
+ * precision.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o gemm_bench gemm_bench.c
+ * OMP_NUM_THREADS=8 OMP_PROC_BIND=close OMP_PLACES=cores ./gemm_bench [max_n]
+ */
+
+#include <assert.h>
+#include <math.h>     /* fabs */
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atoi */
+#include <string.h>   /* memset */
+
+#include "gemm.h"
+#include "parallel_rng.h"
+
+#define MAX_N       4096
+#define NAIVE_MAX_N 1024
+#define SAMPLES     64
+#define SEED        12345
+
+// Relative tolerance of the float result against the double one.
+#define TOLERANCE   1e-4
+
+/* Computes C = A * B for n x n row-major matrices. */
+typedef void (*gemm_fn_t)(int n, const float* A, const float* B, float* C);
+
+void gemm_naive(int n, const float* A, const float* B, float* C) {
+  int i;
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      float sum = 0.0f;
+      for (int k = 0; k < n; ++k) {
+        sum += A[(long)i * n + k] * B[(long)k * n + j];
+      }
+      C[(long)i * n + j] = sum;
+    }
+  }
+}
+
+void gemm_ikj(int n, const float* A, const float* B, float* C) {
+  int i;
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < n; ++i) {
+    float* c = C + (long)i * n;
+    for (int j = 0; j < n; ++j) c[j] = 0.0f;
+    for (int k = 0; k < n; ++k) {
+      float a = A[(long)i * n + k];
+      const float* b = B + (long)k * n;
+      #pragma omp simd
+      for (int j = 0; j < n; ++j) {
+        c[j] += a * b[j];
+      }
+    }
+  }
+}
+
+void fill(float* m, long len, uint64_t seed) {
+  long i;
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < len; ++i) {
+    m[i] = (float)rng_uniform(seed, (uint64_t)i) - 0.5f;
+  }
+}
+
+/**
+ * Checks SAMPLES random entries of C against a double-precision dot product.
+ */
+int check(int n, const float* A, const float* B, const float* C) {
+  for (int s = 0; s < SAMPLES; ++s) {
+    long i = rng_bounded(rng_u64(SEED + 1, 2 * s), n);
+    long j = rng_bounded(rng_u64(SEED + 1, 2 * s + 1), n);
+    double ref = 0.0, norm = 0.0;
+    for (long k = 0; k < n; ++k) {
+      double t = (double)A[i * n + k] * B[k * n + j];
+      ref += t;
+      norm += fabs(t);
+    }
+    if (fabs(C[i * n + j] - ref) > TOLERANCE * norm) return 0;
+  }
+  return 1;
+}
+
+/**
+ * Best time of a few runs of a variant. `kern` is NULL for the plain loops.
+ */
+double time_variant(gemm_fn_t fn, const gemm_kernel_t* kern, int n,
+                    const float* A, const float* B, float* C) {
+  double best = 1e30;
+  int reps = (n <= 1024) ? 5 : 2;
+
+  for (int r = 0; r < reps; ++r) {
+    double t = omp_get_wtime();
+    if (kern != NULL) {
+      memset(C, 0, sizeof(float) * n * n);
+      gemm_sgemm_with(kern, n, n, n, A, n, B, n, C, n);
+    }
+    else {
+      fn(n, A, B, C);
+    }
+    t = omp_get_wtime() - t;
+    if (t < best) best = t;
+  }
+
+  return best;
+}
+
+void report(const char* name, int n, double t, int correct) {
+  printf("%s,%d,%d,%.5f,%.2f,%s\n", name, n, omp_get_max_threads(), t,
+         2.0 * n * n * n / t * 1e-9, correct ? "yes" : "NO");
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  int max_n = MAX_N;
+  if (argc > 1) max_n = atoi(argv[1]);
+
+  const gemm_kernel_t* kernels[3];
+  int nkernels = 0;
+  kernels[nkernels++] = &gemm_kernel_generic;
+#if GEMM_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    kernels[nkernels++] = &gemm_kernel_avx2;
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    kernels[nkernels++] = &gemm_kernel_avx512;
+  }
+#endif
+
+  printf("variant,n,threads,time_s,GFLOP_per_s,correct\n");
+
+  for (int n = 256; n <= max_n; n *= 2) {
+    long len = (long)n * n;
+    float* A = (float*)malloc(sizeof(float) * len);
+    float* B = (float*)malloc(sizeof(float) * len);
+    float* C = (float*)malloc(sizeof(float) * len);
+    assert(A != NULL && B != NULL && C != NULL);
+
+    fill(A, len, SEED);
+    fill(B, len, SEED + 2);
+
+    if (n <= NAIVE_MAX_N) {
+      double t = time_variant(gemm_naive, NULL, n, A, B, C);
+      report("naive", n, t, check(n, A, B, C));
+    }
+
+    double t = time_variant(gemm_ikj, NULL, n, A, B, C);
+    report("ikj", n, t, check(n, A, B, C));
+
+    for (int kk = 0; kk < nkernels; ++kk) {
+      t = time_variant(NULL, kernels[kk], n, A, B, C);
+      report(kernels[kk]->name, n, t, check(n, A, B, C));
+    }
+
+    free(A);
+    free(B);
+    free(C);
+  }
+
+  return 0;
+}
@@ -0,0 +1,247 @@
+/**
+ * Parallel histogram strategies behind a single call.
+ *
+ * v11.2_eg_histogram.c protects every bucket with an omp_lock_t and takes a
+ * set/unset pair for every sample. That's a good example of locks, but the
+ * lock overhead dominates the run time. This header offers the following
+ * strategies:
+ *
+ * - HIST_LOCKS:   the original, one omp_lock_t per bucket (for comparison).
+ * - HIST_ATOMIC:  `#pragma omp atomic` increment on the shared histogram.
+ *                 No locks, but threads still fight for the hot buckets.
+ * - HIST_PRIVATE: every thread fills its own private histogram, and the copies
+ *                 are then merged in parallel, each thread adding up a range of
+ *                 buckets. No synchronization at all while counting, but needs
+ *                 nthreads * nbuckets counters.
+ * - HIST_HYBRID:  every thread keeps a small direct-mapped cache of
+ *                 (bucket, count) pairs and only flushes a count to the shared
+ *                 histogram with an atomic add when the entry is evicted. Hot
+ *                 entries are never evicted; samples that collide with them
+ *                 go straight to the shared histogram. With skewed data (few
+ *                 very frequent buckets) the hot buckets are counted without
+ *                 any atomics, and memory stays bounded for any nbuckets.
+ *
+ * Usage:
+ *
+ *   histogram_fill(samples, nvals, hist, nbuckets, HIST_PRIVATE);
+ *
+ * `hist` must have nbuckets counters; it is overwritten. Every sample must be
+ * in [0, nbuckets).
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <assert.h>
+#include <omp.h>
+#include <stdlib.h>   /* malloc, aligned_alloc, free */
+
+#include "padded_accumulator.h"   /* CACHE_LINE_SIZE */
+
+// Entries in each thread's cache for HIST_HYBRID. Must be a power of 2.
+#ifndef HIST_CACHE_SIZE
+#define HIST_CACHE_SIZE 1024
+#endif
+
+// A cached bucket with at least this many pending samples is considered hot
+// and is not evicted by HIST_HYBRID.
+#ifndef HIST_EVICT_THRESHOLD
+#define HIST_EVICT_THRESHOLD 8
+#endif
+
+typedef enum {
+  HIST_LOCKS = 0,
+  HIST_ATOMIC,
+  HIST_PRIVATE,
+  HIST_HYBRID,
+  HIST_NUM_STRATEGIES
+} hist_strategy_t;
+
+static const char* const hist_strategy_names[HIST_NUM_STRATEGIES] = {
+  "locks", "atomic", "private", "hybrid"
+};
+
+/**
+ * One lock per bucket, as in v11.2_eg_histogram.c (but on the heap).
+ */
+static inline void histogram_fill_locks(const int* samples, long nvals,
+                                        int* hist, int nbuckets) {
+  omp_lock_t* locks = (omp_lock_t*)malloc(sizeof(omp_lock_t) * nbuckets);
+  long i;
+  assert(locks != NULL);
+
+  #pragma omp parallel
+  {
+    #pragma omp for
+    for (int b = 0; b < nbuckets; ++b) {
+      omp_init_lock(&locks[b]);
+      hist[b] = 0;
+    }
+
+    #pragma omp for
+    for (i = 0; i < nvals; ++i) {
+      int ival = samples[i];
+      omp_set_lock(&locks[ival]);
+      hist[ival]++;
+      omp_unset_lock(&locks[ival]);
+    }
+
+    #pragma omp for
+    for (int b = 0; b < nbuckets; ++b) {
+      omp_destroy_lock(&locks[b]);
+    }
+  }
+
+  free(locks);
+}
+
+/**
+ * Atomic increments on the shared histogram.
+ */
+static inline void histogram_fill_atomic(const int* samples, long nvals,
+                                         int* hist, int nbuckets) {
+  long i;
+
+  #pragma omp parallel
+  {
+    #pragma omp for
+    for (int b = 0; b < nbuckets; ++b) {
+      hist[b] = 0;
+    }
+
+    #pragma omp for
+    for (i = 0; i < nvals; ++i) {
+      #pragma omp atomic update
+      hist[samples[i]]++;
+    }
+  }
+}
+
+/**
+ * Private histogram per thread, merged with a parallel reduction over the
+ * buckets. Every copy starts on its own cache line, so with few buckets
+ * neighbouring threads don't count into the same line.
+ */
+static inline void histogram_fill_private(const int* samples, long nvals,
+                                          int* hist, int nbuckets) {
+  int nthreads = omp_get_max_threads();
+  size_t line = CACHE_LINE_SIZE / sizeof(int);
+  size_t stride = ((size_t)nbuckets + line - 1) / line * line;
+  int* copies = (int*)aligned_alloc(CACHE_LINE_SIZE,
+                                    sizeof(int) * nthreads * stride);
+  long i;
+  assert(copies != NULL);
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    int id = omp_get_thread_num();
+    int nthrds = omp_get_num_threads();
+
+    // Each thread zeroes (and so first-touches) its own copy.
+    int* mine = copies + id * stride;
+    for (int b = 0; b < nbuckets; ++b) {
+      mine[b] = 0;
+    }
+
+    #pragma omp for
+    for (i = 0; i < nvals; ++i) {
+      mine[samples[i]]++;
+    }
+
+    // Implicit barrier above: all copies are complete. Now every thread adds
+    // up a range of buckets across all copies.
+    #pragma omp for
+    for (int b = 0; b < nbuckets; ++b) {
+      int total = 0;
+      for (int t = 0; t < nthrds; ++t) {
+        total += copies[t * stride + b];
+      }
+      hist[b] = total;
+    }
+  }
+
+  free(copies);
+}
+
+/**
+ * Per-thread direct-mapped counter cache, flushed with atomic adds.
+ */
+static inline void histogram_fill_hybrid(const int* samples, long nvals,
+                                         int* hist, int nbuckets) {
+  long i;
+
+  #pragma omp parallel
+  {
+    int keys[HIST_CACHE_SIZE];
+    int counts[HIST_CACHE_SIZE];
+
+    for (int c = 0; c < HIST_CACHE_SIZE; ++c) {
+      keys[c] = -1;
+      counts[c] = 0;
+    }
+
+    #pragma omp for
+    for (int b = 0; b < nbuckets; ++b) {
+      hist[b] = 0;
+    }
+
+    // Implicit barrier above: hist is zeroed before anybody flushes into it.
+    #pragma omp for
+    for (i = 0; i < nvals; ++i) {
+      int ival = samples[i];
+      int slot = ival & (HIST_CACHE_SIZE - 1);
+
+      if (keys[slot] == ival) {
+        counts[slot]++;
+      }
+      else if (counts[slot] < HIST_EVICT_THRESHOLD) {
+        // The slot is empty or holds a cold bucket: take it over.
+        if (keys[slot] >= 0) {
+          #pragma omp atomic update
+          hist[keys[slot]] += counts[slot];
+        }
+        keys[slot] = ival;
+        counts[slot] = 1;
+      }
+      else {
+        // The slot holds a hot bucket: leave it there and count this sample
+        // directly.
+        #pragma omp atomic update
+        hist[ival]++;
+      }
+    }
+
+    for (int c = 0; c < HIST_CACHE_SIZE; ++c) {
+      if (keys[c] >= 0) {
+        #pragma omp atomic update
+        hist[keys[c]] += counts[c];
+      }
+    }
+  }
+}
+
+/**
+ * Computes the histogram of `samples` with the given strategy.
+ * @param samples  Values, each in [0, nbuckets).
+ * @param nvals    Number of samples.
+ * @param hist     Output, nbuckets counters.
+ * @param nbuckets Number of buckets.
+ * @param strategy One of hist_strategy_t.
+ */
+static inline void histogram_fill(const int* samples, long nvals, int* hist,
+                                  int nbuckets, hist_strategy_t strategy) {
+  switch (strategy) {
+    case HIST_LOCKS:
+      histogram_fill_locks(samples, nvals, hist, nbuckets); break;
+    case HIST_ATOMIC:
+      histogram_fill_atomic(samples, nvals, hist, nbuckets); break;
+    case HIST_PRIVATE:
+      histogram_fill_private(samples, nvals, hist, nbuckets); break;
+    case HIST_HYBRID:
+      histogram_fill_hybrid(samples, nvals, hist, nbuckets); break;
+    default:
+      assert(0 && "unknown histogram strategy");
+  }
+}
+
+#endif  // HISTOGRAM_H
@@ -0,0 +1,138 @@
+/**
+ * Benchmark of the histogram strategies in histogram.h.
+ *
+ * Runs every strategy over two distributions of samples:
+ * - uniform: every bucket is equally likely, like v11.2_eg_histogram.c.
+ * - zipf:    bucket k has probability proportional to 1 / (k + 1)^ZIPF_S, so a
+ *            handful of buckets get most of the samples.
+ *
+ * The samples come from the counter-based generator in parallel_rng.h, so
+ * they are generated in parallel and are the same for any number of threads.
+ * Each result is checked against a serial histogram.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o histogram_bench histogram_bench.c -lm
+ * OMP_NUM_THREADS=8 ./histogram_bench [nbuckets] [nvals] [reps]
+ */
+
+#define _GNU_SOURCE   // sched_getcpu, for omp_affinity.h. Before any #include.
+
+#include <assert.h>
+#include <math.h>     /* pow */
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atoi, atol */
+#include <string.h>   /* memcmp */
+
+#include "histogram.h"
+#include "omp_affinity.h"
+#include "parallel_rng.h"
+
+#define NBUCKETS   100000
+#define NVALS      10000000
+#define REPS       5
+#define SEED       12345
+
+// Zipf exponent.
+#define ZIPF_S     1.1
+
+/**
+ * Uniform samples in [0, nbuckets).
+ */
+void generate_uniform(int* samples, long nvals, int nbuckets, uint64_t seed) {
+  rng_fill_ints(samples, nvals, nbuckets, seed);
+}
+
+/**
+ * Zipf-distributed samples in [0, nbuckets), by inverting the CDF with a
+ * binary search.
+ */
+void generate_zipf(int* samples, long nvals, int nbuckets, uint64_t seed) {
+  double* cdf = (double*)malloc(sizeof(double) * nbuckets);
+  double total = 0.0;
+  long i;
+  assert(cdf != NULL);
+
+  for (int k = 0; k < nbuckets; ++k) {
+    total += 1.0 / pow(k + 1, ZIPF_S);
+    cdf[k] = total;
+  }
+
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < nvals; ++i) {
+    double u = rng_uniform(seed, (uint64_t)i) * total;
+    int lo = 0, hi = nbuckets - 1;
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (cdf[mid] > u) hi = mid;
+      else lo = mid + 1;
+    }
+    samples[i] = lo;
+  }
+
+  free(cdf);
+}
+
+/**
+ * Serial histogram, used to check the parallel ones.
+ */
+void histogram_serial(const int* samples, long nvals, int* hist,
+                      int nbuckets) {
+  for (int b = 0; b < nbuckets; ++b) hist[b] = 0;
+  for (long i = 0; i < nvals; ++i) hist[samples[i]]++;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  int nbuckets = NBUCKETS;
+  long nvals = NVALS;
+  int reps = REPS;
+
+  if (argc > 1) nbuckets = atoi(argv[1]);
+  if (argc > 2) nvals = atol(argv[2]);
+  if (argc > 3) reps = atoi(argv[3]);
+
+  int* samples = (int*)malloc(sizeof(int) * nvals);
+  int* expected = (int*)malloc(sizeof(int) * nbuckets);
+  int* hist = (int*)malloc(sizeof(int) * nbuckets);
+  assert(samples != NULL && expected != NULL && hist != NULL);
+
+  printf("threads = %d, nbuckets = %d, nvals = %ld\n", omp_get_max_threads(),
+         nbuckets, nvals);
+  affinity_print_settings(stdout);
+  printf("distribution,strategy,best_s,Msamples_per_s,correct\n");
+
+  for (int dist = 0; dist < 2; ++dist) {
+    const char* dist_name = dist ? "zipf" : "uniform";
+
+    double gen_time = -omp_get_wtime();
+    if (dist) generate_zipf(samples, nvals, nbuckets, SEED);
+    else generate_uniform(samples, nvals, nbuckets, SEED);
+    gen_time += omp_get_wtime();
+    fprintf(stderr, "Generated %s samples in %.4fs\n", dist_name, gen_time);
+
+    histogram_serial(samples, nvals, expected, nbuckets);
+
+    for (int s = 0; s < HIST_NUM_STRATEGIES; ++s) {
+      double best = 1e30;
+
+      for (int r = 0; r < reps; ++r) {
+        double elapsed = -omp_get_wtime();
+        histogram_fill(samples, nvals, hist, nbuckets, (hist_strategy_t)s);
+        elapsed += omp_get_wtime();
+        if (elapsed < best) best = elapsed;
+      }
+
+      int correct = (memcmp(hist, expected, sizeof(int) * nbuckets) == 0);
+      printf("%s,%s,%.4f,%.1f,%s\n", dist_name, hist_strategy_names[s], best,
+             nvals / best * 1e-6, correct ? "yes" : "NO");
+    }
+  }
+
+  free(samples);
+  free(expected);
+  free(hist);
+  return 0;
+}
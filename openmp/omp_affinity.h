@@ -0,0 +1,159 @@
+/**
+ * Thread placement (OMP_PROC_BIND / OMP_PLACES) for the OpenMP examples.
+ *
+ * Without a binding, the OS is free to move threads between cores and
+ * sockets, which shows up as run-to-run variance and, after first touch, as
+ * threads working on memory that belongs to another socket. The binding is
+ * controlled by two environment variables:
+ *
+ * - OMP_PROC_BIND: false, true, primary (master), close or spread.
+ * - OMP_PLACES:    threads, cores, sockets, or an explicit list such as
+ *                  "{0:4},{4:4}".
+ *
+ * Both are read once, when the OpenMP runtime starts (for libgomp that's
+ * before main()), so they can't be changed from inside the program with
+ * setenv(). affinity_exec() runs a program in a child process with the given
+ * settings instead.
+ *
+ * Usage:
+ *
+ *   affinity_print_settings(stdout);     // What the runtime is using.
+ *   affinity_print_thread_map(stdout);   // Thread -> place -> CPU.
+ *
+ *   affinity_config_t spread = { "spread", "cores" };
+ *   affinity_exec(&spread, argv);        // Re-runs argv with that binding.
+ *
+ * Linux only (sched_getcpu). <sched.h> only declares sched_getcpu() with
+ * _GNU_SOURCE, and feature macros only work before the first system header,
+ * so define it at the top of the program (or compile with -D_GNU_SOURCE).
+ */
+
+#ifndef OMP_AFFINITY_H
+#define OMP_AFFINITY_H
+
+#ifndef _GNU_SOURCE
+#error "omp_affinity.h needs _GNU_SOURCE defined before any #include"
+#endif
+
+#include <omp.h>
+#include <sched.h>      /* sched_getcpu */
+#include <stdio.h>
+#include <stdlib.h>     /* malloc, free, getenv, setenv, unsetenv */
+#include <sys/wait.h>   /* waitpid */
+#include <unistd.h>     /* fork, execv, _exit */
+
+typedef struct {
+  const char* proc_bind;  // Value for OMP_PROC_BIND, or NULL to leave unset.
+  const char* places;     // Value for OMP_PLACES, or NULL to leave unset.
+} affinity_config_t;
+
+static inline const char* affinity_proc_bind_name(omp_proc_bind_t bind) {
+  switch (bind) {
+    case omp_proc_bind_false:  return "false";
+    case omp_proc_bind_true:   return "true";
+    case omp_proc_bind_master: return "primary";
+    case omp_proc_bind_close:  return "close";
+    case omp_proc_bind_spread: return "spread";
+    default:                   return "unknown";
+  }
+}
+
+/**
+ * Prints the environment variables, the binding policy the runtime actually
+ * uses, and the list of places with their processors.
+ */
+static inline void affinity_print_settings(FILE* f) {
+  const char* bind_env = getenv("OMP_PROC_BIND");
+  const char* places_env = getenv("OMP_PLACES");
+  int nplaces = omp_get_num_places();
+
+  fprintf(f, "# OMP_PROC_BIND=%s OMP_PLACES=%s\n",
+          bind_env ? bind_env : "(unset)", places_env ? places_env : "(unset)");
+  fprintf(f, "# proc_bind = %s, places = %d, procs = %d, max threads = %d\n",
+          affinity_proc_bind_name(omp_get_proc_bind()), nplaces,
+          omp_get_num_procs(), omp_get_max_threads());
+
+  for (int p = 0; p < nplaces; ++p) {
+    int nprocs = omp_get_place_num_procs(p);
+    int* ids = (int*)malloc(sizeof(int) * (nprocs > 0 ? nprocs : 1));
+    if (ids == NULL) return;
+
+    omp_get_place_proc_ids(p, ids);
+    fprintf(f, "# place %d: {", p);
+    for (int k = 0; k < nprocs; ++k) {
+      fprintf(f, "%s%d", k ? "," : "", ids[k]);
+    }
+    fprintf(f, "}\n");
+    free(ids);
+  }
+}
+
+/**
+ * Starts a parallel region and prints, for every thread, its place and the
+ * CPU it is running on. An unbound thread has place -1 and may show up on a
+ * different CPU every time.
+ */
+static inline void affinity_print_thread_map(FILE* f) {
+  int nthreads = omp_get_max_threads();
+  int* cpu = (int*)malloc(sizeof(int) * nthreads);
+  int* place = (int*)malloc(sizeof(int) * nthreads);
+  int team = 0;
+
+  if (cpu == NULL || place == NULL) {
+    free(cpu);
+    free(place);
+    return;
+  }
+
+  #pragma omp parallel
+  {
+    int id = omp_get_thread_num();
+    if (id < nthreads) {
+      cpu[id] = sched_getcpu();
+      place[id] = omp_get_place_num();
+    }
+    #pragma omp single
+    team = omp_get_num_threads();
+  }
+
+  fprintf(f, "# thread -> place -> cpu:");
+  for (int t = 0; t < team && t < nthreads; ++t) {
+    fprintf(f, " %d->%d->%d", t, place[t], cpu[t]);
+  }
+  fprintf(f, "\n");
+
+  free(cpu);
+  free(place);
+}
+
+/**
+ * Runs this same program again, with arguments `argv`, in a child process
+ * with OMP_PROC_BIND and OMP_PLACES set from `config`, and waits for it.
+ * @return The exit status of the child, or -1 if it couldn't be started.
+ */
+static inline int affinity_exec(const affinity_config_t* config,
+                                char* const argv[]) {
+  pid_t pid;
+  int status;
+
+  fflush(NULL);
+  pid = fork();
+  if (pid < 0) return -1;
+
+  if (pid == 0) {
+    if (config->proc_bind) setenv("OMP_PROC_BIND", config->proc_bind, 1);
+    else unsetenv("OMP_PROC_BIND");
+    if (config->places) setenv("OMP_PLACES", config->places, 1);
+    else unsetenv("OMP_PLACES");
+
+    // /proc/self/exe, so it works whatever the current directory is.
+    execv("/proc/self/exe", argv);
+    perror("execv");
+    _exit(127);
+  }
+
+  if (waitpid(pid, &status, 0) < 0) return -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+#endif  // OMP_AFFINITY_H
@@ -0,0 +1,156 @@
+/**
+ * Lightweight per-thread timeline tracing for OpenMP programs.
+ *
+ * Every thread appends (name, start, end) records to its own ring buffer, so
+ * recording an event is two omp_get_wtime() calls and a few stores: no locks,
+ * no allocation and no printf on the hot path. When the buffer is full, the
+ * oldest records are overwritten. At exit, all buffers are written as a
+ * Chrome trace (open chrome://tracing or https://ui.perfetto.dev and load the
+ * file), with one row per thread.
+ *
+ * Usage:
+ *
+ *   trace_init(NULL);                  // Once, before the parallel regions.
+ *
+ *   #pragma omp parallel
+ *   {
+ *     double t0 = trace_now();
+ *     big_calc(...);
+ *     trace_record("big_calc", t0);    // [t0, now] on this thread's row.
+ *
+ *     TRACE_BARRIER("after big_calc"); // #pragma omp barrier, timed.
+ *
+ *     #pragma omp for nowait
+ *     for (...) { ... }
+ *     TRACE_BARRIER("end of for");     // Explicit stand-in for the implicit
+ *   }                                  // barrier, so it can be timed.
+ *
+ * For a barrier, the record spans from the thread's arrival to its departure,
+ * so its length is exactly the time the thread spent waiting for the others.
+ *
+ * The output file is trace.json, or the one named by the OMP_TRACE_FILE
+ * environment variable, or the one passed to trace_init().
+ */
+
+#ifndef OMP_TRACE_H
+#define OMP_TRACE_H
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* aligned_alloc, free, atexit, getenv */
+
+#include "padded_accumulator.h"   /* CACHE_LINE_SIZE */
+
+// Records per thread. Must be a power of 2.
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 4096
+#endif
+
+typedef struct {
+  const char* name;   // Must be a string literal (or live until exit).
+  double start;
+  double end;
+} trace_event_t;
+
+typedef struct {
+  // Aligned, so two threads never write to the same cache line.
+  _Alignas(CACHE_LINE_SIZE) unsigned long count;
+  trace_event_t events[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static trace_ring_t* trace_rings = NULL;
+static int trace_nrings = 0;
+static double trace_t0 = 0.0;
+static const char* trace_file = "trace.json";
+
+static inline double trace_now(void) {
+  return omp_get_wtime();
+}
+
+/**
+ * Records an event on the calling thread's row, from `start` until now.
+ */
+static inline void trace_record(const char* name, double start) {
+  int id = omp_get_thread_num();
+  if (id >= trace_nrings) return;
+
+  trace_ring_t* ring = &trace_rings[id];
+  trace_event_t* e = &ring->events[ring->count & (TRACE_RING_SIZE - 1)];
+  e->name = name;
+  e->start = start;
+  e->end = omp_get_wtime();
+  ring->count++;
+}
+
+#define TRACE_BARRIER(name)                 \
+  do {                                      \
+    double trace_arrival_ = trace_now();    \
+    _Pragma("omp barrier")                  \
+    trace_record((name), trace_arrival_);   \
+  } while (0)
+
+/**
+ * Writes all the buffers as a Chrome trace. Called at exit by trace_init().
+ */
+static void trace_dump(void) {
+  FILE* f = fopen(trace_file, "w");
+  int first = 1;
+
+  if (f == NULL) {
+    perror(trace_file);
+    return;
+  }
+
+  fprintf(f, "{\"traceEvents\": [\n");
+  for (int t = 0; t < trace_nrings; ++t) {
+    trace_ring_t* ring = &trace_rings[t];
+    unsigned long begin =
+      ring->count > TRACE_RING_SIZE ? ring->count - TRACE_RING_SIZE : 0;
+
+    for (unsigned long i = begin; i < ring->count; ++i) {
+      trace_event_t* e = &ring->events[i & (TRACE_RING_SIZE - 1)];
+      // Chrome traces use microseconds.
+      fprintf(f, "%s  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, "
+              "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+              first ? "" : ",\n", e->name, t, (e->start - trace_t0) * 1e6,
+              (e->end - e->start) * 1e6);
+      first = 0;
+    }
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+
+  fprintf(stderr, "Trace written to %s\n", trace_file);
+  free(trace_rings);
+  trace_rings = NULL;
+  trace_nrings = 0;
+}
+
+/**
+ * Allocates one ring per thread (omp_get_max_threads()) and registers
+ * trace_dump() to run at exit.
+ * @param filename Output file, or NULL for OMP_TRACE_FILE / trace.json.
+ */
+static void trace_init(const char* filename) {
+  const char* env = getenv("OMP_TRACE_FILE");
+
+  if (filename != NULL) trace_file = filename;
+  else if (env != NULL) trace_file = env;
+
+  trace_nrings = omp_get_max_threads();
+  trace_rings = (trace_ring_t*)aligned_alloc(
+    CACHE_LINE_SIZE, sizeof(trace_ring_t) * trace_nrings);
+  if (trace_rings == NULL) {
+    trace_nrings = 0;
+    return;
+  }
+
+  for (int t = 0; t < trace_nrings; ++t) {
+    trace_rings[t].count = 0;
+  }
+
+  trace_t0 = omp_get_wtime();
+  atexit(trace_dump);
+}
+
+#endif  // OMP_TRACE_H
@@ -0,0 +1,379 @@
+/**
+ * OMPT tool that profiles any OpenMP program without changing its code.
+ *
+ * OMPT is the tools interface of OpenMP 5.0: when the runtime starts, it
+ * looks for a function called ompt_start_tool() in the libraries listed in
+ * OMP_TOOL_LIBRARIES, and, if it's there, calls back into it on every
+ * parallel region, task, lock, critical section, barrier, etc.
+ *
+ * This tool records, per parallel region (identified by the address of the
+ * code that opened it):
+ * - number of executions and total/maximum duration;
+ * - tasks created and tasks completed inside it;
+ * - number of lock/nest lock/critical/atomic/ordered acquisitions and the
+ *   time spent waiting for them;
+ * - time spent waiting at barriers (explicit, implicit and taskwait).
+ * Wait times are added up over all threads, so they can be larger than the
+ * duration of the region. At shutdown, it prints one summary line per region
+ * to stderr, with the function name of the region (compile the program with
+ * -rdynamic to see names instead of addresses).
+ *
+ * Note: the tool only runs under an OMPT-capable runtime, such as LLVM's
+ * libomp or Intel's. GCC's libgomp doesn't implement OMPT (as of GCC 13) and
+ * never loads the tool, so either compile the programs with clang, or run
+ * gcc-compiled programs with libomp preloaded (it also implements the GOMP_*
+ * entry points that gcc emits).
+ *
+ * Compile the tool (omp-tools.h ships with clang/libomp, in its resource
+ * directory, or pass -I<path to omp-tools.h>):
+ * gcc -O2 -shared -fPIC -I"$(clang -print-resource-dir)/include" \
+ *     -o libompt_profiler.so ompt_profiler.c -ldl -lpthread
+ *
+ * Run, e.g.:
+ * clang -O2 -fopenmp -rdynamic -o v07_eg_critical_section \
+ *     v07_eg_critical_section.c
+ * OMP_TOOL_LIBRARIES=./libompt_profiler.so ./v07_eg_critical_section
+ *
+ * gcc -O2 -fopenmp -rdynamic -o v16_eg02_fib_tasks v16_eg02_fib_tasks.c
+ * LD_PRELOAD=<path to libomp.so> \
+ *   OMP_TOOL_LIBRARIES=./libompt_profiler.so ./v16_eg02_fib_tasks
+ */
+
+#define _GNU_SOURCE   /* dladdr */
+
+#include <dlfcn.h>
+#include <omp-tools.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free */
+#include <time.h>     /* clock_gettime */
+
+// Maximum number of distinct parallel regions that are tracked.
+#define MAX_REGIONS 256
+
+// Indexes for the mutex statistics.
+enum { MTX_LOCK, MTX_NEST_LOCK, MTX_CRITICAL, MTX_ATOMIC, MTX_ORDERED,
+       MTX_OTHER, MTX_KINDS };
+
+static const char* const mutex_names[MTX_KINDS] = {
+  "lock", "nest_lock", "critical", "atomic", "ordered", "other"
+};
+
+/* Statistics of one parallel region (all its executions). */
+typedef struct {
+  const void* codeptr;
+  long executions;
+  long total_ns;
+  long max_ns;
+  unsigned int max_threads;
+  long tasks_created;
+  long tasks_completed;
+  long mutex_count[MTX_KINDS];
+  long mutex_wait_ns[MTX_KINDS];
+  long barrier_wait_ns;
+} region_stats_t;
+
+/* One execution of a parallel region, kept in parallel_data->ptr. */
+typedef struct {
+  region_stats_t* stats;
+  long start_ns;
+} region_instance_t;
+
+static region_stats_t regions[MAX_REGIONS];
+static int num_regions = 0;
+static pthread_mutex_t regions_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Everything that happens outside of any parallel region (or that can't be
+// attributed to one) goes here.
+static region_stats_t outside = { NULL, 0, 0, 0, 0, 0, 0, { 0 }, { 0 }, 0 };
+
+static ompt_get_parallel_info_t get_parallel_info;
+
+// Per-thread timestamps of the mutex / barrier waits in progress.
+static __thread long mutex_wait_start;
+static __thread long barrier_wait_start;
+static __thread region_stats_t* barrier_wait_region;
+
+static long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void atomic_add(long* p, long v) {
+  __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+}
+
+static void atomic_max(long* p, long v) {
+  long old = __atomic_load_n(p, __ATOMIC_RELAXED);
+  while (v > old &&
+         !__atomic_compare_exchange_n(p, &old, v, 0, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+  }
+}
+
+/**
+ * Finds (or creates) the statistics of the region opened at `codeptr`.
+ */
+static region_stats_t* region_lookup(const void* codeptr) {
+  region_stats_t* r = &outside;
+
+  pthread_mutex_lock(&regions_mutex);
+  for (int i = 0; i < num_regions; ++i) {
+    if (regions[i].codeptr == codeptr) {
+      r = &regions[i];
+      break;
+    }
+  }
+  if (r == &outside && num_regions < MAX_REGIONS) {
+    r = &regions[num_regions++];
+    r->codeptr = codeptr;
+  }
+  pthread_mutex_unlock(&regions_mutex);
+
+  return r;
+}
+
+/**
+ * Statistics of the innermost parallel region of the calling thread.
+ */
+static region_stats_t* current_region(ompt_data_t* parallel_data) {
+  if (parallel_data == NULL && get_parallel_info != NULL) {
+    int team_size;
+    if (get_parallel_info(0, &parallel_data, &team_size) != 2) {
+      parallel_data = NULL;
+    }
+  }
+  if (parallel_data != NULL && parallel_data->ptr != NULL) {
+    return ((region_instance_t*)parallel_data->ptr)->stats;
+  }
+  return &outside;
+}
+
+static int mutex_index(ompt_mutex_t kind) {
+  switch (kind) {
+    case ompt_mutex_lock:      return MTX_LOCK;
+    case ompt_mutex_test_lock: return MTX_LOCK;
+    case ompt_mutex_nest_lock: return MTX_NEST_LOCK;
+    case ompt_mutex_test_nest_lock: return MTX_NEST_LOCK;
+    case ompt_mutex_critical:  return MTX_CRITICAL;
+    case ompt_mutex_atomic:    return MTX_ATOMIC;
+    case ompt_mutex_ordered:   return MTX_ORDERED;
+    default:                   return MTX_OTHER;
+  }
+}
+
+/* Callbacks */
+
+static void on_parallel_begin(ompt_data_t* encountering_task_data,
+                              const ompt_frame_t* encountering_task_frame,
+                              ompt_data_t* parallel_data,
+                              unsigned int requested_parallelism, int flags,
+                              const void* codeptr_ra) {
+  region_instance_t* inst = malloc(sizeof(region_instance_t));
+  (void)encountering_task_data;
+  (void)encountering_task_frame;
+  (void)flags;
+
+  if (inst == NULL) {
+    parallel_data->ptr = NULL;
+    return;
+  }
+
+  inst->stats = region_lookup(codeptr_ra);
+  inst->start_ns = now_ns();
+  parallel_data->ptr = inst;
+
+  pthread_mutex_lock(&regions_mutex);
+  if (requested_parallelism > inst->stats->max_threads) {
+    inst->stats->max_threads = requested_parallelism;
+  }
+  pthread_mutex_unlock(&regions_mutex);
+}
+
+static void on_parallel_end(ompt_data_t* parallel_data,
+                            ompt_data_t* encountering_task_data, int flags,
+                            const void* codeptr_ra) {
+  region_instance_t* inst = parallel_data->ptr;
+  (void)encountering_task_data;
+  (void)flags;
+  (void)codeptr_ra;
+
+  if (inst == NULL) return;
+
+  long elapsed = now_ns() - inst->start_ns;
+  atomic_add(&inst->stats->executions, 1);
+  atomic_add(&inst->stats->total_ns, elapsed);
+  atomic_max(&inst->stats->max_ns, elapsed);
+
+  parallel_data->ptr = NULL;
+  free(inst);
+}
+
+static void on_task_create(ompt_data_t* encountering_task_data,
+                           const ompt_frame_t* encountering_task_frame,
+                           ompt_data_t* new_task_data, int flags,
+                           int has_dependences, const void* codeptr_ra) {
+  (void)encountering_task_data;
+  (void)encountering_task_frame;
+  (void)has_dependences;
+  (void)codeptr_ra;
+
+  // Only explicit tasks; the runtime also reports the initial task.
+  if (!(flags & ompt_task_explicit)) return;
+
+  region_stats_t* r = current_region(NULL);
+  new_task_data->ptr = r;
+  atomic_add(&r->tasks_created, 1);
+}
+
+static void on_task_schedule(ompt_data_t* prior_task_data,
+                             ompt_task_status_t prior_task_status,
+                             ompt_data_t* next_task_data) {
+  (void)next_task_data;
+
+  if (prior_task_status == ompt_task_complete && prior_task_data != NULL &&
+      prior_task_data->ptr != NULL) {
+    atomic_add(&((region_stats_t*)prior_task_data->ptr)->tasks_completed, 1);
+  }
+}
+
+static void on_mutex_acquire(ompt_mutex_t kind, unsigned int hint,
+                             unsigned int impl, ompt_wait_id_t wait_id,
+                             const void* codeptr_ra) {
+  (void)kind;
+  (void)hint;
+  (void)impl;
+  (void)wait_id;
+  (void)codeptr_ra;
+  mutex_wait_start = now_ns();
+}
+
+static void on_mutex_acquired(ompt_mutex_t kind, ompt_wait_id_t wait_id,
+                              const void* codeptr_ra) {
+  int k = mutex_index(kind);
+  region_stats_t* r = current_region(NULL);
+  (void)wait_id;
+  (void)codeptr_ra;
+
+  atomic_add(&r->mutex_count[k], 1);
+  atomic_add(&r->mutex_wait_ns[k], now_ns() - mutex_wait_start);
+}
+
+static void on_sync_region_wait(ompt_sync_region_t kind,
+                                ompt_scope_endpoint_t endpoint,
+                                ompt_data_t* parallel_data,
+                                ompt_data_t* task_data,
+                                const void* codeptr_ra) {
+  (void)kind;
+  (void)task_data;
+  (void)codeptr_ra;
+
+  // At the end of the implicit barrier of a parallel region, the region may
+  // already be gone, so remember it from the beginning of the wait.
+  if (endpoint == ompt_scope_begin) {
+    barrier_wait_region = current_region(parallel_data);
+    barrier_wait_start = now_ns();
+  }
+  else if (barrier_wait_region != NULL) {
+    atomic_add(&barrier_wait_region->barrier_wait_ns,
+               now_ns() - barrier_wait_start);
+    barrier_wait_region = NULL;
+  }
+}
+
+/* Tool setup */
+
+static void register_callback(ompt_set_callback_t set_callback,
+                              ompt_callbacks_t event, ompt_callback_t cb,
+                              const char* name) {
+  int result = set_callback(event, cb);
+  if (result == ompt_set_never || result == ompt_set_error) {
+    fprintf(stderr, "[ompt_profiler] %s is not supported by this runtime\n",
+            name);
+  }
+}
+
+static int tool_initialize(ompt_function_lookup_t lookup,
+                           int initial_device_num, ompt_data_t* tool_data) {
+  ompt_set_callback_t set_callback =
+    (ompt_set_callback_t)lookup("ompt_set_callback");
+  (void)initial_device_num;
+  (void)tool_data;
+
+  get_parallel_info =
+    (ompt_get_parallel_info_t)lookup("ompt_get_parallel_info");
+
+  register_callback(set_callback, ompt_callback_parallel_begin,
+                    (ompt_callback_t)on_parallel_begin, "parallel_begin");
+  register_callback(set_callback, ompt_callback_parallel_end,
+                    (ompt_callback_t)on_parallel_end, "parallel_end");
+  register_callback(set_callback, ompt_callback_task_create,
+                    (ompt_callback_t)on_task_create, "task_create");
+  register_callback(set_callback, ompt_callback_task_schedule,
+                    (ompt_callback_t)on_task_schedule, "task_schedule");
+  register_callback(set_callback, ompt_callback_mutex_acquire,
+                    (ompt_callback_t)on_mutex_acquire, "mutex_acquire");
+  register_callback(set_callback, ompt_callback_mutex_acquired,
+                    (ompt_callback_t)on_mutex_acquired, "mutex_acquired");
+  register_callback(set_callback, ompt_callback_sync_region_wait,
+                    (ompt_callback_t)on_sync_region_wait, "sync_region_wait");
+
+  // Non-zero means "keep the tool active".
+  return 1;
+}
+
+static void print_region(const char* label, const region_stats_t* r) {
+  fprintf(stderr, "%-40s %6ld %11.6f %11.6f %4u %9ld %9ld %11.6f", label,
+          r->executions, r->total_ns * 1e-9, r->max_ns * 1e-9, r->max_threads,
+          r->tasks_created, r->tasks_completed, r->barrier_wait_ns * 1e-9);
+
+  for (int k = 0; k < MTX_KINDS; ++k) {
+    if (r->mutex_count[k] > 0) {
+      fprintf(stderr, "  %s: %ld (%.6fs wait)", mutex_names[k],
+              r->mutex_count[k], r->mutex_wait_ns[k] * 1e-9);
+    }
+  }
+  fprintf(stderr, "\n");
+}
+
+static void tool_finalize(ompt_data_t* tool_data) {
+  (void)tool_data;
+
+  fprintf(stderr, "\n[ompt_profiler] Summary per parallel region\n");
+  fprintf(stderr, "%-40s %6s %11s %11s %4s %9s %9s %11s  %s\n", "region",
+          "execs", "total_s", "max_s", "thr", "tasks_new", "tasks_end",
+          "barrier_s", "mutexes");
+
+  for (int i = 0; i < num_regions; ++i) {
+    char label[64];
+    Dl_info info;
+
+    if (dladdr(regions[i].codeptr, &info) && info.dli_sname != NULL) {
+      snprintf(label, sizeof(label), "%s+0x%lx", info.dli_sname,
+               (unsigned long)((const char*)regions[i].codeptr -
+                               (const char*)info.dli_saddr));
+    }
+    else {
+      snprintf(label, sizeof(label), "%p", regions[i].codeptr);
+    }
+    print_region(label, &regions[i]);
+  }
+
+  print_region("(outside parallel regions)", &outside);
+}
+
+/**
+ * Entry point of the tool, called by the OpenMP runtime at startup.
+ */
+ompt_start_tool_result_t* ompt_start_tool(unsigned int omp_version,
+                                          const char* runtime_version) {
+  static ompt_start_tool_result_t result = {
+    tool_initialize, tool_finalize, { .value = 0 }
+  };
+  (void)omp_version;
+
+  fprintf(stderr, "[ompt_profiler] Attached to %s\n", runtime_version);
+  return &result;
+}
@@ -0,0 +1,86 @@
+/**
+ * Per-thread accumulators padded to a full cache line.
+ *
+ * pi_omp_v1_false_sharing.c keeps one partial sum per thread in a packed
+ * `double sum[NUM_THREADS]`, so several threads write to the same cache line
+ * and keep invalidating each other's copy of it. Giving every slot its own
+ * cache line (alignment + padding) avoids that, while still letting the
+ * master thread read all partial sums at the end.
+ *
+ * Usage:
+ *
+ *   padded_double_t* sum = padded_double_alloc(nthreads);
+ *   ...
+ *   sum[id].value += 4.0 / (1.0 + x * x);
+ *   ...
+ *   padded_free(sum);
+ *
+ * The cache line size is taken from the compiler when it knows it
+ * (__GCC_DESTRUCTIVE_SIZE, GCC >= 12), or guessed from the target
+ * architecture otherwise. It can be forced with -DCACHE_LINE_SIZE=128, e.g.
+ * on Intel CPUs whose adjacent-line prefetcher works on pairs of lines.
+ */
+
+#ifndef PADDED_ACCUMULATOR_H
+#define PADDED_ACCUMULATOR_H
+
+#include <stdlib.h>   /* aligned_alloc, free */
+
+#ifndef CACHE_LINE_SIZE
+#  if defined(__GCC_DESTRUCTIVE_SIZE)
+#    define CACHE_LINE_SIZE __GCC_DESTRUCTIVE_SIZE
+#  elif defined(__aarch64__) && defined(__APPLE__)
+#    define CACHE_LINE_SIZE 128
+#  elif defined(__powerpc64__) || defined(__s390x__)
+#    define CACHE_LINE_SIZE 128
+#  else
+#    define CACHE_LINE_SIZE 64
+#  endif
+#endif
+
+// Since the member is aligned to CACHE_LINE_SIZE, sizeof() of each struct is
+// rounded up to a whole cache line, so consecutive array elements never share
+// one.
+typedef struct {
+  _Alignas(CACHE_LINE_SIZE) double value;
+} padded_double_t;
+
+typedef struct {
+  _Alignas(CACHE_LINE_SIZE) long value;
+} padded_long_t;
+
+typedef struct {
+  _Alignas(CACHE_LINE_SIZE) int value;
+} padded_int_t;
+
+_Static_assert(sizeof(padded_double_t) == CACHE_LINE_SIZE,
+               "padded_double_t must fill exactly one cache line");
+
+/**
+ * Allocates `n` zeroed, cache-line-aligned slots.
+ * @param  n Number of slots (usually the number of threads).
+ * @return   Pointer to the slots, or NULL. Release with padded_free().
+ */
+static inline padded_double_t* padded_double_alloc(int n) {
+  padded_double_t* p = aligned_alloc(CACHE_LINE_SIZE, sizeof(*p) * n);
+  for (int i = 0; p != NULL && i < n; ++i) p[i].value = 0.0;
+  return p;
+}
+
+static inline padded_long_t* padded_long_alloc(int n) {
+  padded_long_t* p = aligned_alloc(CACHE_LINE_SIZE, sizeof(*p) * n);
+  for (int i = 0; p != NULL && i < n; ++i) p[i].value = 0;
+  return p;
+}
+
+static inline padded_int_t* padded_int_alloc(int n) {
+  padded_int_t* p = aligned_alloc(CACHE_LINE_SIZE, sizeof(*p) * n);
+  for (int i = 0; p != NULL && i < n; ++i) p[i].value = 0;
+  return p;
+}
+
+static inline void padded_free(void* p) {
+  free(p);
+}
+
+#endif  // PADDED_ACCUMULATOR_H
@@ -0,0 +1,125 @@
+/**
+ * Counter-based random numbers for filling arrays from many threads.
+ *
+ * `rand()` keeps a hidden global state, so it can't be called from several
+ * threads, and the value of samples[i] depends on how many calls happened
+ * before it. Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy
+ * as 1, 2, 3", SC'11) is instead a pure function of (key, counter): the key
+ * is derived from the seed, the counter from the element's index. Any thread
+ * can compute element i on its own, and for a given seed the array is
+ * bit-identical no matter how many threads fill it, or in which order.
+ *
+ * Usage:
+ *
+ *   rng_fill_ints(samples, nvals, nbuckets, seed);    // in [0, nbuckets)
+ *   double u = rng_uniform(seed, i);                  // in [0, 1)
+ */
+
+#ifndef PARALLEL_RNG_H
+#define PARALLEL_RNG_H
+
+#include <stdint.h>
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+/**
+ * Philox4x32 with 10 rounds.
+ * @param ctr 128-bit counter, as 4 words. Replaced by the output.
+ * @param key 64-bit key, as 2 words.
+ */
+static inline void philox4x32_10(uint32_t ctr[4], const uint32_t key[2]) {
+  uint32_t k0 = key[0], k1 = key[1];
+
+  for (int r = 0; r < 10; ++r) {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * ctr[0];
+    uint64_t p1 = (uint64_t)PHILOX_M1 * ctr[2];
+    uint32_t hi0 = (uint32_t)(p0 >> 32), lo0 = (uint32_t)p0;
+    uint32_t hi1 = (uint32_t)(p1 >> 32), lo1 = (uint32_t)p1;
+
+    ctr[0] = hi1 ^ ctr[1] ^ k0;
+    ctr[1] = lo1;
+    ctr[2] = hi0 ^ ctr[3] ^ k1;
+    ctr[3] = lo0;
+
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+}
+
+/**
+ * Two 64-bit random values for `index`: one Philox call per pair of elements.
+ */
+static inline void rng_pair(uint64_t seed, uint64_t index, uint64_t out[2]) {
+  uint32_t key[2] = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+  uint32_t ctr[4] = { (uint32_t)index, (uint32_t)(index >> 32), 0, 0 };
+
+  philox4x32_10(ctr, key);
+  out[0] = ((uint64_t)ctr[0] << 32) | ctr[1];
+  out[1] = ((uint64_t)ctr[2] << 32) | ctr[3];
+}
+
+/**
+ * 64 random bits for element `i` of the stream given by `seed`.
+ */
+static inline uint64_t rng_u64(uint64_t seed, uint64_t i) {
+  uint64_t r[2];
+  rng_pair(seed, i / 2, r);
+  return r[i % 2];
+}
+
+/**
+ * Uniform double in [0, 1) for element `i`, with 53 random bits.
+ */
+static inline double rng_uniform(uint64_t seed, uint64_t i) {
+  return (rng_u64(seed, i) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * High 64 bits of the 128-bit product a * b.
+ */
+static inline uint64_t rng_mulhi64(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  return (uint64_t)(((unsigned __int128)a * b) >> 64);
+#else
+  // No 128-bit integers (e.g. 32-bit targets, MSVC): multiply 32-bit halves.
+  uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+  uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+  uint64_t lo_lo = a_lo * b_lo, lo_hi = a_lo * b_hi;
+  uint64_t hi_lo = a_hi * b_lo, hi_hi = a_hi * b_hi;
+  uint64_t mid = (lo_lo >> 32) + (uint32_t)lo_hi + (uint32_t)hi_lo;
+  return hi_hi + (lo_hi >> 32) + (hi_lo >> 32) + (mid >> 32);
+#endif
+}
+
+/**
+ * Maps 64 random bits to [0, range) with a multiply-shift instead of `%`.
+ * The bias is at most range / 2^64, which is negligible (`rand() % range`
+ * is biased by up to range / RAND_MAX).
+ */
+static inline int rng_bounded(uint64_t r, int range) {
+  return (int)rng_mulhi64(r, (uint64_t)range);
+}
+
+/**
+ * Fills `out` with n integers uniformly distributed in [0, range), in
+ * parallel. The result only depends on `seed`, not on the number of threads.
+ */
+static inline void rng_fill_ints(int* out, long n, int range, uint64_t seed) {
+  long p, npairs = (n + 1) / 2;
+
+  #pragma omp parallel for schedule(static)
+  for (p = 0; p < npairs; ++p) {
+    uint64_t r[2];
+    rng_pair(seed, (uint64_t)p, r);
+
+    out[2 * p] = rng_bounded(r[0], range);
+    if (2 * p + 1 < n) {
+      out[2 * p + 1] = rng_bounded(r[1], range);
+    }
+  }
+}
+
+#endif  // PARALLEL_RNG_H
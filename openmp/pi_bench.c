@@ -0,0 +1,378 @@
+/**
+ * Benchmark driver for the pi integration examples.
+ *
+ * pi_serial.c, pi_omp_v1_false_sharing.c, pi_omp_v2_synchronization.c and
+ * pi_omp_v3_reduction.c each have their own main(), step count and thread
+ * count, so their timings can't be compared directly. This program runs the
+ * same four strategies as kernels, with the same number of steps, over a sweep
+ * of thread counts (1, 2, 4, ... up to the number of processors). The
+ * false-sharing kernel is also run with padded slots (padded_accumulator.h),
+ * to show what the fix is worth.
+ *
+ * Every (kernel, threads) pair is run a few times as warm-up and then
+ * `reps` times for real. The median and 95th percentile wall times are
+ * reported, together with the speedup and parallel efficiency relative to the
+ * median time of the serial kernel.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o pi_bench pi_bench.c -lm
+ * ./pi_bench [num_steps] [reps] [csv|json] [max_threads]
+ *
+ * Example:
+ * ./pi_bench 100000000 10 json > pi_bench.json
+ */
+
+#define _GNU_SOURCE   // sched_getcpu, for omp_affinity.h. Before any #include.
+
+#include <assert.h>
+#include <math.h>     /* fabs, ceil */
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, qsort, atol, atoi */
+#include <string.h>   /* strcmp */
+
+#include "omp_affinity.h"
+#include "padded_accumulator.h"
+
+#define WARMUP_REPS 2
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifdef __VERSION__
+#define COMPILER_VERSION __VERSION__
+#else
+#define COMPILER_VERSION "unknown"
+#endif
+
+/* Every kernel receives the number of steps and threads and returns pi. */
+typedef double (*pi_kernel_t)(long num_steps, int nthreads);
+
+double pi_serial(long num_steps, int nthreads);
+double pi_false_sharing(long num_steps, int nthreads);
+double pi_padded(long num_steps, int nthreads);
+double pi_critical(long num_steps, int nthreads);
+double pi_reduction(long num_steps, int nthreads);
+
+typedef struct {
+  const char* name;
+  pi_kernel_t kernel;
+  int parallel;  // 0 if the kernel ignores nthreads.
+} pi_variant_t;
+
+static const pi_variant_t variants[] = {
+  { "serial",        pi_serial,        0 },
+  { "false_sharing", pi_false_sharing, 1 },
+  { "padded",        pi_padded,        1 },
+  { "critical",      pi_critical,      1 },
+  { "reduction",     pi_reduction,     1 },
+};
+
+#define NUM_VARIANTS (int)(sizeof(variants) / sizeof(variants[0]))
+
+/* Statistics for one (kernel, threads) measurement. */
+typedef struct {
+  const char* name;
+  int nthreads;
+  double pi;
+  double median;
+  double p95;
+  double speedup;
+  double efficiency;
+} pi_result_t;
+
+/**
+ * Same loop as pi_serial.c.
+ */
+double pi_serial(long num_steps, int nthreads) {
+  double x, sum = 0.0;
+  double step = 1.0 / (double)num_steps;
+  long i;
+
+  (void)nthreads;
+
+  for (i = 0; i < num_steps; ++i) {
+    x = (i + 0.5) * step;
+    sum = sum + 4.0 / (1.0 + x * x);
+  }
+
+  return step * sum;
+}
+
+/**
+ * Same strategy as pi_omp_v1_false_sharing.c: cyclic distribution with one
+ * slot per thread in a packed array.
+ */
+double pi_false_sharing(long num_steps, int nthreads) {
+  double step = 1.0 / (double)num_steps;
+  double pi = 0.0;
+  double* sum = (double*)malloc(sizeof(double) * nthreads);
+  int actual_threads = 0;
+  assert(sum != NULL);
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    long i;
+    int id = omp_get_thread_num();
+    int nthrds = omp_get_num_threads();
+    double x;
+
+    if (id == 0) {
+      actual_threads = nthrds;
+    }
+
+    for (i = id, sum[id] = 0.0; i < num_steps; i += nthrds) {
+      x = (i + 0.5) * step;
+      sum[id] += 4.0 / (1.0 + x * x);
+    }
+  }
+
+  for (int i = 0; i < actual_threads; ++i) {
+    pi += sum[i] * step;
+  }
+
+  free(sum);
+  return pi;
+}
+
+/**
+ * Same as pi_false_sharing(), but each thread's slot is padded to a whole
+ * cache line (see padded_accumulator.h).
+ */
+double pi_padded(long num_steps, int nthreads) {
+  double step = 1.0 / (double)num_steps;
+  double pi = 0.0;
+  padded_double_t* sum = padded_double_alloc(nthreads);
+  int actual_threads = 0;
+  assert(sum != NULL);
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    long i;
+    int id = omp_get_thread_num();
+    int nthrds = omp_get_num_threads();
+    double x;
+
+    if (id == 0) {
+      actual_threads = nthrds;
+    }
+
+    for (i = id; i < num_steps; i += nthrds) {
+      x = (i + 0.5) * step;
+      sum[id].value += 4.0 / (1.0 + x * x);
+    }
+  }
+
+  for (int i = 0; i < actual_threads; ++i) {
+    pi += sum[i].value * step;
+  }
+
+  padded_free(sum);
+  return pi;
+}
+
+/**
+ * Same strategy as pi_omp_v2_synchronization.c: cyclic distribution with a
+ * private partial sum, combined in a critical section.
+ */
+double pi_critical(long num_steps, int nthreads) {
+  double step = 1.0 / (double)num_steps;
+  double pi = 0.0;
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    long i;
+    int id = omp_get_thread_num();
+    int nthrds = omp_get_num_threads();
+    double x, local_sum = 0.0;
+
+    for (i = id; i < num_steps; i += nthrds) {
+      x = (i + 0.5) * step;
+      local_sum += 4.0 / (1.0 + x * x);
+    }
+
+    #pragma omp critical
+    {
+      pi += local_sum * step;
+    }
+  }
+
+  return pi;
+}
+
+/**
+ * Same strategy as pi_omp_v3_reduction.c: parallel for with reduction(+).
+ */
+double pi_reduction(long num_steps, int nthreads) {
+  double x, sum = 0.0;
+  double step = 1.0 / (double)num_steps;
+  long i;
+
+  #pragma omp parallel for num_threads(nthreads) private(x) reduction(+:sum)
+  for (i = 0; i < num_steps; ++i) {
+    x = (i + 0.5) * step;
+    sum += 4.0 / (1.0 + x * x);
+  }
+
+  return step * sum;
+}
+
+int compare_doubles(const void* a, const void* b) {
+  double da = *(const double*)a;
+  double db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+/**
+ * Nearest-rank percentile of an already sorted array.
+ * @param  sorted Sorted samples.
+ * @param  n      Number of samples.
+ * @param  p      Percentile, between 0 and 100.
+ * @return        The percentile value.
+ */
+double percentile(const double* sorted, int n, double p) {
+  int idx = (int)ceil(p / 100.0 * n) - 1;
+  if (idx < 0) idx = 0;
+  if (idx >= n) idx = n - 1;
+  return sorted[idx];
+}
+
+/**
+ * Runs one kernel `reps` times (after warm-up) and fills in the statistics.
+ */
+void measure(const pi_variant_t* v, long num_steps, int nthreads, int reps,
+             pi_result_t* result) {
+  double* times = (double*)malloc(sizeof(double) * reps);
+  double pi = 0.0;
+  assert(times != NULL);
+
+  for (int r = 0; r < WARMUP_REPS; ++r) {
+    pi = v->kernel(num_steps, nthreads);
+  }
+
+  for (int r = 0; r < reps; ++r) {
+    double elapsed = 0.0;
+    elapsed -= omp_get_wtime();
+    pi = v->kernel(num_steps, nthreads);
+    elapsed += omp_get_wtime();
+    times[r] = elapsed;
+  }
+
+  qsort(times, reps, sizeof(double), compare_doubles);
+
+  result->name = v->name;
+  result->nthreads = nthreads;
+  result->pi = pi;
+  result->median = (reps % 2) ? times[reps / 2]
+                              : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+  result->p95 = percentile(times, reps, 95.0);
+
+  free(times);
+}
+
+void print_csv(const pi_result_t* results, int n, long num_steps, int reps) {
+  printf("# compiler: %s\n", COMPILER_VERSION);
+  affinity_print_settings(stdout);
+  printf("kernel,threads,num_steps,reps,pi,abs_error,median_s,p95_s,"
+         "speedup,efficiency\n");
+  for (int i = 0; i < n; ++i) {
+    const pi_result_t* r = &results[i];
+    printf("%s,%d,%ld,%d,%.15f,%.3e,%.6f,%.6f,%.3f,%.3f\n", r->name,
+           r->nthreads, num_steps, reps, r->pi, fabs(r->pi - M_PI), r->median,
+           r->p95, r->speedup, r->efficiency);
+  }
+}
+
+void print_json(const pi_result_t* results, int n, long num_steps, int reps) {
+  printf("{\n");
+  printf("  \"compiler\": \"%s\",\n", COMPILER_VERSION);
+  printf("  \"num_procs\": %d,\n", omp_get_num_procs());
+  printf("  \"proc_bind\": \"%s\",\n",
+         affinity_proc_bind_name(omp_get_proc_bind()));
+  printf("  \"num_steps\": %ld,\n", num_steps);
+  printf("  \"reps\": %d,\n", reps);
+  printf("  \"results\": [\n");
+  for (int i = 0; i < n; ++i) {
+    const pi_result_t* r = &results[i];
+    printf("    {\"kernel\": \"%s\", \"threads\": %d, \"pi\": %.15f, "
+           "\"abs_error\": %.3e, \"median_s\": %.6f, \"p95_s\": %.6f, "
+           "\"speedup\": %.3f, \"efficiency\": %.3f}%s\n",
+           r->name, r->nthreads, r->pi, fabs(r->pi - M_PI), r->median, r->p95,
+           r->speedup, r->efficiency, (i == n - 1) ? "" : ",");
+  }
+  printf("  ]\n");
+  printf("}\n");
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  long num_steps = 100000000;
+  int reps = 5;
+  int json = 0;
+  int max_threads = omp_get_num_procs();
+
+  if (argc > 1) num_steps = atol(argv[1]);
+  if (argc > 2) reps = atoi(argv[2]);
+  if (argc > 3) json = (strcmp(argv[3], "json") == 0);
+  if (argc > 4) max_threads = atoi(argv[4]);
+
+  if (num_steps <= 0 || reps <= 0 || max_threads <= 0) {
+    fprintf(stderr, "Usage: %s [num_steps] [reps] [csv|json] [max_threads]\n",
+            argv[0]);
+    return 1;
+  }
+
+  // Don't let the runtime hand us fewer threads than we asked for.
+  omp_set_dynamic(0);
+
+  // Thread sweep: powers of two, plus max_threads itself.
+  int thread_counts[64];
+  int num_counts = 0;
+  for (int t = 1; t < max_threads && num_counts < 63; t *= 2) {
+    thread_counts[num_counts++] = t;
+  }
+  thread_counts[num_counts++] = max_threads;
+
+  pi_result_t* results =
+    (pi_result_t*)malloc(sizeof(pi_result_t) * NUM_VARIANTS * num_counts);
+  assert(results != NULL);
+  int n = 0;
+
+  // The serial kernel is the baseline for speedup and efficiency.
+  double serial_median = 0.0;
+
+  for (int v = 0; v < NUM_VARIANTS; ++v) {
+    for (int c = 0; c < num_counts; ++c) {
+      int nthreads = thread_counts[c];
+
+      if (!variants[v].parallel && nthreads != 1) {
+        continue;
+      }
+
+      fprintf(stderr, "Running %s with %d thread(s)...\n", variants[v].name,
+              nthreads);
+      measure(&variants[v], num_steps, nthreads, reps, &results[n]);
+
+      if (!variants[v].parallel) {
+        serial_median = results[n].median;
+      }
+
+      results[n].speedup = serial_median / results[n].median;
+      results[n].efficiency = results[n].speedup / nthreads;
+      n++;
+    }
+  }
+
+  if (json) {
+    print_json(results, n, num_steps, reps);
+  }
+  else {
+    print_csv(results, n, num_steps, reps);
+  }
+
+  free(results);
+  return 0;
+}
@@ -0,0 +1,250 @@
+/**
+ * Parallel calculation of pi with vectorized kernels.
+ *
+ * In pi_serial.c and pi_omp_v3_reduction.c every iteration adds to the same
+ * `sum`, so each addition has to wait for the previous one, and the division
+ * in between can't be overlapped with anything else. Here each thread gets a
+ * contiguous block of steps and runs one of these kernels on it:
+ *
+ * - scalar:  the original loop.
+ * - omp_simd: the original loop with `#pragma omp simd reduction(+:sum)`, so
+ *   the compiler keeps one partial sum per vector lane.
+ * - avx2:    4 lanes x NUM_ACC independent accumulators, with intrinsics.
+ * - avx512:  8 lanes x NUM_ACC independent accumulators, with intrinsics.
+ *
+ * The AVX paths are compiled with the `target` attribute and picked at run
+ * time with __builtin_cpu_supports, so the same binary runs on machines
+ * without AVX-512 (or without AVX at all). Partial sums of the threads are
+ * combined with an OpenMP reduction.
+ *
+ * Each step costs 6 floating-point operations (2 for x, 2 for 1 + x * x, 1
+ * division and 1 addition), which is what the GFLOP/s column is based on.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o pi_omp_v4_simd pi_omp_v4_simd.c
+ * ./pi_omp_v4_simd [num_steps] [num_threads]
+ */
+
+#include <limits.h>   /* INT_MAX */
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* atol, atoi */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_DISPATCH 1
+#else
+#define HAVE_X86_DISPATCH 0
+#endif
+
+// Number of independent vector accumulators in the intrinsics kernels.
+#define NUM_ACC 4
+
+// Floating-point operations per integration step.
+#define FLOPS_PER_STEP 6.0
+
+/* A kernel sums 4 / (1 + x^2) for steps [begin, end). */
+typedef double (*block_kernel_t)(long begin, long end, double step);
+
+/**
+ * The loop from pi_serial.c, restricted to [begin, end).
+ */
+double block_scalar(long begin, long end, double step) {
+  double x, sum = 0.0;
+  for (long i = begin; i < end; ++i) {
+    x = (i + 0.5) * step;
+    sum += 4.0 / (1.0 + x * x);
+  }
+  return sum;
+}
+
+/**
+ * Same loop, but vectorized by the compiler.
+ *
+ * The index is an int offset from `begin`: without AVX-512DQ there is no
+ * vector conversion from 64-bit integers to double, and the compiler would
+ * silently fall back to scalar code.
+ */
+double block_omp_simd(long begin, long end, double step) {
+  double x, sum = 0.0;
+
+  while (begin < end) {
+    int n = (end - begin > INT_MAX) ? INT_MAX : (int)(end - begin);
+    double base = (double)begin + 0.5;
+
+    #pragma omp simd private(x) reduction(+:sum)
+    for (int j = 0; j < n; ++j) {
+      x = (base + j) * step;
+      sum += 4.0 / (1.0 + x * x);
+    }
+    begin += n;
+  }
+
+  return sum;
+}
+
+#if HAVE_X86_DISPATCH
+
+/**
+ * AVX2 kernel: NUM_ACC accumulators of 4 doubles each, so 4 * NUM_ACC
+ * divisions are in flight per iteration.
+ */
+__attribute__((target("avx2")))
+double block_avx2(long begin, long end, double step) {
+  const long width = 4 * NUM_ACC;
+  const __m256d vstep = _mm256_set1_pd(step);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d four = _mm256_set1_pd(4.0);
+  const __m256d block_inc = _mm256_set1_pd((double)width);
+  __m256d acc[NUM_ACC];
+  __m256d idx[NUM_ACC];
+  long i = begin;
+  double lanes[4], sum = 0.0;
+  int a;
+
+  // idx[a] holds (i + 0.5) for the 4 lanes of accumulator a.
+  for (a = 0; a < NUM_ACC; ++a) {
+    double base = (double)begin + 0.5 + 4 * a;
+    acc[a] = _mm256_setzero_pd();
+    idx[a] = _mm256_set_pd(base + 3, base + 2, base + 1, base);
+  }
+
+  for (; i + width <= end; i += width) {
+    for (a = 0; a < NUM_ACC; ++a) {
+      __m256d x = _mm256_mul_pd(idx[a], vstep);
+      __m256d den = _mm256_add_pd(one, _mm256_mul_pd(x, x));
+      acc[a] = _mm256_add_pd(acc[a], _mm256_div_pd(four, den));
+      idx[a] = _mm256_add_pd(idx[a], block_inc);
+    }
+  }
+
+  for (a = 1; a < NUM_ACC; ++a) {
+    acc[0] = _mm256_add_pd(acc[0], acc[a]);
+  }
+  _mm256_storeu_pd(lanes, acc[0]);
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+  // Leftover steps.
+  return sum + block_scalar(i, end, step);
+}
+
+/**
+ * AVX-512 kernel: NUM_ACC accumulators of 8 doubles each.
+ */
+__attribute__((target("avx512f")))
+double block_avx512(long begin, long end, double step) {
+  const long width = 8 * NUM_ACC;
+  const __m512d vstep = _mm512_set1_pd(step);
+  const __m512d one = _mm512_set1_pd(1.0);
+  const __m512d four = _mm512_set1_pd(4.0);
+  const __m512d block_inc = _mm512_set1_pd((double)width);
+  __m512d acc[NUM_ACC];
+  __m512d idx[NUM_ACC];
+  long i = begin;
+  int a;
+
+  for (a = 0; a < NUM_ACC; ++a) {
+    double base = (double)begin + 0.5 + 8 * a;
+    acc[a] = _mm512_setzero_pd();
+    idx[a] = _mm512_set_pd(base + 7, base + 6, base + 5, base + 4,
+                           base + 3, base + 2, base + 1, base);
+  }
+
+  for (; i + width <= end; i += width) {
+    for (a = 0; a < NUM_ACC; ++a) {
+      __m512d x = _mm512_mul_pd(idx[a], vstep);
+      __m512d den = _mm512_add_pd(one, _mm512_mul_pd(x, x));
+      acc[a] = _mm512_add_pd(acc[a], _mm512_div_pd(four, den));
+      idx[a] = _mm512_add_pd(idx[a], block_inc);
+    }
+  }
+
+  for (a = 1; a < NUM_ACC; ++a) {
+    acc[0] = _mm512_add_pd(acc[0], acc[a]);
+  }
+
+  return _mm512_reduce_add_pd(acc[0]) + block_scalar(i, end, step);
+}
+
+#endif
+
+/**
+ * Splits [0, num_steps) into one contiguous block per thread, runs `kernel`
+ * on each block and adds the partial sums with a reduction.
+ */
+double pi_parallel(block_kernel_t kernel, long num_steps, int nthreads) {
+  double step = 1.0 / (double)num_steps;
+  double sum = 0.0;
+
+  #pragma omp parallel num_threads(nthreads) reduction(+:sum)
+  {
+    int id = omp_get_thread_num();
+    int nthrds = omp_get_num_threads();
+    long chunk = num_steps / nthrds;
+    long rem = num_steps % nthrds;
+    long begin = id * chunk + (id < rem ? id : rem);
+    long end = begin + chunk + (id < rem ? 1 : 0);
+
+    sum += kernel(begin, end, step);
+  }
+
+  return step * sum;
+}
+
+/**
+ * Runs one kernel and prints pi, the time and the GFLOP/s achieved.
+ */
+double run(const char* name, block_kernel_t kernel, long num_steps,
+           int nthreads) {
+  double pi, elapsed = 0.0;
+
+  // Warm-up.
+  pi_parallel(kernel, num_steps / 10 + 1, nthreads);
+
+  elapsed -= omp_get_wtime();
+  pi = pi_parallel(kernel, num_steps, nthreads);
+  elapsed += omp_get_wtime();
+
+  printf("%-9s pi = %.15f  time = %8.4fs  %7.2f GFLOP/s\n", name, pi, elapsed,
+         FLOPS_PER_STEP * num_steps / elapsed * 1e-9);
+  return elapsed;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  long num_steps = 499999999;
+  int nthreads = omp_get_num_procs();
+
+  if (argc > 1) num_steps = atol(argv[1]);
+  if (argc > 2) nthreads = atoi(argv[2]);
+
+  printf("num_steps = %ld, threads = %d\n", num_steps, nthreads);
+
+  double t_scalar = run("scalar", block_scalar, num_steps, nthreads);
+  double t_simd = run("omp_simd", block_omp_simd, num_steps, nthreads);
+  printf("          speedup over scalar: %.2fx\n", t_scalar / t_simd);
+
+#if HAVE_X86_DISPATCH
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    double t = run("avx2", block_avx2, num_steps, nthreads);
+    printf("          speedup over scalar: %.2fx\n", t_scalar / t);
+  }
+  else {
+    printf("avx2      not supported by this CPU, skipped.\n");
+  }
+
+  if (__builtin_cpu_supports("avx512f")) {
+    double t = run("avx512", block_avx512, num_steps, nthreads);
+    printf("          speedup over scalar: %.2fx\n", t_scalar / t);
+  }
+  else {
+    printf("avx512    not supported by this CPU, skipped.\n");
+  }
+#endif
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * Parallel calculation of pi with a deterministic, compensated reduction.
+ *
+ * With hundreds of millions of steps, the plain `sum +=` of
+ * pi_omp_v2_synchronization.c and the `reduction(+:sum)` of
+ * pi_omp_v3_reduction.c lose several digits to rounding, and the result
+ * changes with the number of threads, because the order of the additions does.
+ *
+ * Here the steps are cut into blocks of BLOCK_STEPS, whose boundaries only
+ * depend on num_steps. Each block is summed with Kahan's compensated
+ * summation, and the block sums are then added in a fixed pairwise tree. The
+ * threads only decide *who* computes each block, never the order of any
+ * addition, so the result is bit-identical for any number of threads.
+ *
+ * The blocks are distributed with `omp for`, so it scales like the plain
+ * reduction; the extra cost is a constant 3 additions per step. Since the
+ * error no longer grows with num_steps, the step count only has to be large
+ * enough for the discretization error (about 1 / (12 * num_steps^2)), e.g.
+ * 10^7 steps already give an error close to DBL_EPSILON.
+ *
+ * Note: don't compile this with -ffast-math (or -Ofast), which allows the
+ * compiler to optimize the compensation away.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o pi_omp_v5_compensated pi_omp_v5_compensated.c -lm
+ * ./pi_omp_v5_compensated [max_threads]
+ */
+
+#include <assert.h>
+#include <math.h>     /* fabs */
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atoi */
+
+// Steps per block. Fixed, so that block boundaries don't depend on threads.
+#define BLOCK_STEPS 65536L
+
+// Independent Kahan accumulators per block.
+#define KAHAN_LANES 4
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * Kahan summation of 4 / (1 + x^2) over steps [begin, end).
+ *
+ * Kahan's update is a chain of 4 dependent additions, which would make the
+ * loop much slower than the plain one. So KAHAN_LANES independent
+ * (sum, compensation) pairs are interleaved, step i going to lane i %
+ * KAHAN_LANES, and the lanes are added at the end in a fixed order.
+ */
+double kahan_block(long begin, long end, double step) {
+  double sum[KAHAN_LANES] = { 0.0 }, c[KAHAN_LANES] = { 0.0 };
+  double x, y, t;
+  long i = begin;
+  int l;
+
+  for (; i + KAHAN_LANES <= end; i += KAHAN_LANES) {
+    for (l = 0; l < KAHAN_LANES; ++l) {
+      x = (i + l + 0.5) * step;
+      y = 4.0 / (1.0 + x * x) - c[l];
+      t = sum[l] + y;
+      c[l] = (t - sum[l]) - y;
+      sum[l] = t;
+    }
+  }
+
+  for (l = 0; i < end; ++i, ++l) {
+    x = (i + 0.5) * step;
+    y = 4.0 / (1.0 + x * x) - c[l];
+    t = sum[l] + y;
+    c[l] = (t - sum[l]) - y;
+    sum[l] = t;
+  }
+
+  for (l = 1; l < KAHAN_LANES; ++l) {
+    sum[0] += sum[l] - c[l];
+  }
+
+  return sum[0] - c[0];
+}
+
+/**
+ * Adds up `n` values in a fixed pairwise tree, in place.
+ * @return The total.
+ */
+double pairwise_sum(double* values, long n) {
+  for (long stride = 1; stride < n; stride *= 2) {
+    for (long i = 0; i + stride < n; i += 2 * stride) {
+      values[i] += values[i + stride];
+    }
+  }
+  return n > 0 ? values[0] : 0.0;
+}
+
+/**
+ * Deterministic, compensated pi.
+ */
+double pi_compensated(long num_steps, int nthreads) {
+  double step = 1.0 / (double)num_steps;
+  long nblocks = (num_steps + BLOCK_STEPS - 1) / BLOCK_STEPS;
+  double* block_sums = (double*)malloc(sizeof(double) * nblocks);
+  double sum;
+  long b;
+  assert(block_sums != NULL);
+
+  #pragma omp parallel for num_threads(nthreads) schedule(static)
+  for (b = 0; b < nblocks; ++b) {
+    long begin = b * BLOCK_STEPS;
+    long end = (begin + BLOCK_STEPS < num_steps) ? begin + BLOCK_STEPS
+                                                 : num_steps;
+    block_sums[b] = kahan_block(begin, end, step);
+  }
+
+  sum = pairwise_sum(block_sums, nblocks);
+  free(block_sums);
+
+  return step * sum;
+}
+
+/**
+ * The plain reduction from pi_omp_v3_reduction.c, for comparison.
+ */
+double pi_reduction(long num_steps, int nthreads) {
+  double x, sum = 0.0;
+  double step = 1.0 / (double)num_steps;
+  long i;
+
+  #pragma omp parallel for num_threads(nthreads) private(x) reduction(+:sum)
+  for (i = 0; i < num_steps; ++i) {
+    x = (i + 0.5) * step;
+    sum += 4.0 / (1.0 + x * x);
+  }
+
+  return step * sum;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  const long steps[] = { 1000000, 10000000, 99000000, 499999999 };
+  const int num_sizes = sizeof(steps) / sizeof(steps[0]);
+  int max_threads = omp_get_num_procs();
+
+  if (argc > 1) max_threads = atoi(argv[1]);
+
+  if (max_threads <= 0) {
+    fprintf(stderr, "Usage: %s [max_threads]\n", argv[0]);
+    return 1;
+  }
+
+  omp_set_dynamic(0);
+
+  printf("%10s %7s | %10s %10s | %10s %10s %s\n", "num_steps", "threads",
+         "reduction", "time", "compensated", "time", "");
+
+  for (int s = 0; s < num_sizes; ++s) {
+    double reference = 0.0;
+
+    for (int t = 1; ; t *= 2) {
+      double t_red = 0.0, t_comp = 0.0, pi_red, pi_comp;
+      if (t > max_threads) t = max_threads;
+
+      t_red -= omp_get_wtime();
+      pi_red = pi_reduction(steps[s], t);
+      t_red += omp_get_wtime();
+
+      t_comp -= omp_get_wtime();
+      pi_comp = pi_compensated(steps[s], t);
+      t_comp += omp_get_wtime();
+
+      if (t == 1) reference = pi_comp;
+
+      // Errors are against M_PI; the last column checks that the compensated
+      // result didn't change with the number of threads.
+      printf("%10ld %7d | %10.3e %9.4fs | %10.3e %9.4fs %s\n", steps[s], t,
+             fabs(pi_red - M_PI), t_red, fabs(pi_comp - M_PI), t_comp,
+             (pi_comp == reference) ? "same" : "DIFFERENT");
+
+      if (t == max_threads) break;
+    }
+  }
+
+  return 0;
+}
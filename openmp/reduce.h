@@ -0,0 +1,272 @@
+/**
+ * Parallel reductions over arrays: sum, min, max, argmax, argmin, and
+ * mean/variance.
+ *
+ * v09.2_eg01_reduction.c shows `reduction(+:avg)` on a 10-element array, and
+ * the MPI examples find their maximum with hand-written scalar loops. This
+ * header puts one tuned version of each reduction behind a function call:
+ *
+ * - sum, min, max: `parallel for simd` with a built-in reduction, so every
+ *   thread keeps its own partial in vector registers.
+ * - argmax, argmin: the array is split in chunks of REDUCE_CHUNK elements.
+ *   The max (min) of a chunk is found with a vectorized loop, and the chunk is
+ *   only scanned again for the index when it beats the thread's best so far.
+ *   The (value, index) partials of the threads are combined with a
+ *   user-defined `declare reduction`. Ties go to the smallest index, so the
+ *   result doesn't depend on the number of threads.
+ * - stats (count, mean, variance): every chunk is reduced with two vectorized
+ *   passes (its mean, then the sum of squared deviations from that mean) while
+ *   it is still in cache, and the chunks are merged with the parallel form of
+ *   Welford's update (Chan et al.), also through a `declare reduction`. This
+ *   doesn't lose precision like sum(x^2) - n * mean^2 does.
+ *
+ * Every function exists for double (suffix _d) and int (suffix _i), except the
+ * stats, which are double only:
+ *
+ *   double s = reduce_sum_d(x, n);
+ *   int m = reduce_max_i(a, n);
+ *   reduce_loc_d_t best = reduce_argmax_d(x, n);   // best.value, best.index
+ *   reduce_stats_t st = reduce_stats_d(x, n);
+ *   double var = reduce_stats_variance(st);
+ *
+ * For an empty array, min/max return the identity (INFINITY / -INFINITY for
+ * double, INT_MAX / INT_MIN for int) and argmax/argmin return index -1; for
+ * any other array the index is valid. NaNs are ignored by min, max, argmin
+ * and argmax (an array of only NaNs gives index 0).
+ *
+ * The reduction operators are also available to your own loops, e.g.
+ * `reduction(argmax_d : best)` or `reduction(welford : st)`. See
+ * ../mpi/reduce_mpi.h for the same reductions across MPI ranks.
+ */
+
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <limits.h>   /* INT_MIN, INT_MAX, LONG_MAX */
+#include <math.h>     /* INFINITY */
+#include <omp.h>
+
+// Elements per chunk for argmax/argmin and stats. Small enough to stay in L1.
+#ifndef REDUCE_CHUNK
+#define REDUCE_CHUNK 2048
+#endif
+
+#define REDUCE_PRAGMA(...) _Pragma(#__VA_ARGS__)
+
+/**
+ * Defines reduce_sum_SUF, reduce_min_SUF, reduce_max_SUF, reduce_argmax_SUF
+ * and reduce_argmin_SUF for arrays of `T`, and the argmax_SUF / argmin_SUF
+ * reduction operators.
+ */
+#define REDUCE_DEFINE(T, SUF, SUM_T, LOWEST, HIGHEST)                          \
+                                                                               \
+typedef struct {                                                               \
+  T value;                                                                     \
+  long index;                                                                  \
+} reduce_loc_##SUF##_t;                                                        \
+                                                                               \
+/* Larger value wins; on a tie, the smaller index. Compared as unsigned so     \
+   the -1 of an empty array loses every tie. */                              \
+static inline reduce_loc_##SUF##_t reduce_loc_##SUF##_max(                     \
+    reduce_loc_##SUF##_t a, reduce_loc_##SUF##_t b) {                          \
+  if (b.value > a.value                                                        \
+      || (b.value == a.value                                                   \
+          && (unsigned long)b.index < (unsigned long)a.index)) {               \
+    return b;                                                                  \
+  }                                                                            \
+  return a;                                                                    \
+}                                                                              \
+                                                                               \
+static inline reduce_loc_##SUF##_t reduce_loc_##SUF##_min(                     \
+    reduce_loc_##SUF##_t a, reduce_loc_##SUF##_t b) {                          \
+  if (b.value < a.value                                                        \
+      || (b.value == a.value                                                   \
+          && (unsigned long)b.index < (unsigned long)a.index)) {               \
+    return b;                                                                  \
+  }                                                                            \
+  return a;                                                                    \
+}                                                                              \
+                                                                               \
+REDUCE_PRAGMA(omp declare reduction(argmax_##SUF : reduce_loc_##SUF##_t :      \
+  omp_out = reduce_loc_##SUF##_max(omp_out, omp_in))                           \
+  initializer(omp_priv = { LOWEST, LONG_MAX }))                                \
+                                                                               \
+REDUCE_PRAGMA(omp declare reduction(argmin_##SUF : reduce_loc_##SUF##_t :      \
+  omp_out = reduce_loc_##SUF##_min(omp_out, omp_in))                           \
+  initializer(omp_priv = { HIGHEST, LONG_MAX }))                               \
+                                                                               \
+static inline SUM_T reduce_sum_##SUF(const T* x, long n) {                     \
+  SUM_T sum = 0;                                                               \
+  long i;                                                                      \
+  _Pragma("omp parallel for simd reduction(+:sum) schedule(static)")           \
+  for (i = 0; i < n; ++i) {                                                    \
+    sum += x[i];                                                               \
+  }                                                                            \
+  return sum;                                                                  \
+}                                                                              \
+                                                                               \
+static inline T reduce_max_##SUF(const T* x, long n) {                         \
+  T max = LOWEST;                                                              \
+  long i;                                                                      \
+  _Pragma("omp parallel for simd reduction(max:max) schedule(static)")         \
+  for (i = 0; i < n; ++i) {                                                    \
+    max = x[i] > max ? x[i] : max;                                             \
+  }                                                                            \
+  return max;                                                                  \
+}                                                                              \
+                                                                               \
+static inline T reduce_min_##SUF(const T* x, long n) {                         \
+  T min = HIGHEST;                                                             \
+  long i;                                                                      \
+  _Pragma("omp parallel for simd reduction(min:min) schedule(static)")         \
+  for (i = 0; i < n; ++i) {                                                    \
+    min = x[i] < min ? x[i] : min;                                             \
+  }                                                                            \
+  return min;                                                                  \
+}                                                                              \
+                                                                               \
+static inline reduce_loc_##SUF##_t reduce_argmax_##SUF(const T* x, long n) {   \
+  reduce_loc_##SUF##_t best = { LOWEST, LONG_MAX };                            \
+  long c;                                                                      \
+  REDUCE_PRAGMA(omp parallel for reduction(argmax_##SUF : best)                \
+                schedule(static))                                              \
+  for (c = 0; c < n; c += REDUCE_CHUNK) {                                      \
+    long end = (n - c < REDUCE_CHUNK) ? n : c + REDUCE_CHUNK;                  \
+    T max = LOWEST;                                                            \
+    _Pragma("omp simd reduction(max:max)")                                     \
+    for (long k = c; k < end; ++k) {                                           \
+      max = x[k] > max ? x[k] : max;                                           \
+    }                                                                          \
+    /* Chunks come in increasing order, so only a larger value can win. */     \
+    if (max > best.value || (max == best.value && best.index == LONG_MAX)) {   \
+      long k = c;                                                              \
+      while (k < end && x[k] != max) ++k;                                      \
+      if (k < end) {                                                           \
+        best.value = max;                                                      \
+        best.index = k;                                                        \
+      }                                                                        \
+    }                                                                          \
+  }                                                                            \
+  /* Nothing compared (only NaNs): element 0 stands for the array. */          \
+  if (best.index == LONG_MAX && n > 0) {                                       \
+    best.value = x[0];                                                         \
+    best.index = 0;                                                            \
+  }                                                                            \
+  if (best.index == LONG_MAX) best.index = -1;                                 \
+  return best;                                                                 \
+}                                                                              \
+                                                                               \
+static inline reduce_loc_##SUF##_t reduce_argmin_##SUF(const T* x, long n) {   \
+  reduce_loc_##SUF##_t best = { HIGHEST, LONG_MAX };                           \
+  long c;                                                                      \
+  REDUCE_PRAGMA(omp parallel for reduction(argmin_##SUF : best)                \
+                schedule(static))                                              \
+  for (c = 0; c < n; c += REDUCE_CHUNK) {                                      \
+    long end = (n - c < REDUCE_CHUNK) ? n : c + REDUCE_CHUNK;                  \
+    T min = HIGHEST;                                                           \
+    _Pragma("omp simd reduction(min:min)")                                     \
+    for (long k = c; k < end; ++k) {                                           \
+      min = x[k] < min ? x[k] : min;                                           \
+    }                                                                          \
+    if (min < best.value || (min == best.value && best.index == LONG_MAX)) {   \
+      long k = c;                                                              \
+      while (k < end && x[k] != min) ++k;                                      \
+      if (k < end) {                                                           \
+        best.value = min;                                                      \
+        best.index = k;                                                        \
+      }                                                                        \
+    }                                                                          \
+  }                                                                            \
+  /* Nothing compared (only NaNs): element 0 stands for the array. */          \
+  if (best.index == LONG_MAX && n > 0) {                                       \
+    best.value = x[0];                                                         \
+    best.index = 0;                                                            \
+  }                                                                            \
+  if (best.index == LONG_MAX) best.index = -1;                                 \
+  return best;                                                                 \
+}
+
+// The double identities are infinite, so arrays of infinities work too.
+REDUCE_DEFINE(double, d, double, -INFINITY, INFINITY)
+REDUCE_DEFINE(int, i, long, INT_MIN, INT_MAX)
+
+/**
+ * Count, mean and sum of squared deviations from the mean (M2) of a set of
+ * values. The variance is M2 / n.
+ */
+typedef struct {
+  long n;
+  double mean;
+  double m2;
+} reduce_stats_t;
+
+/**
+ * Stats of the union of two sets (Chan, Golub and LeVeque's update).
+ */
+static inline reduce_stats_t reduce_stats_merge(reduce_stats_t a,
+                                                reduce_stats_t b) {
+  reduce_stats_t r;
+  double delta;
+
+  if (a.n == 0) return b;
+  if (b.n == 0) return a;
+
+  r.n = a.n + b.n;
+  delta = b.mean - a.mean;
+  r.mean = a.mean + delta * ((double)b.n / r.n);
+  r.m2 = a.m2 + b.m2 + delta * delta * ((double)a.n * b.n / r.n);
+  return r;
+}
+
+#pragma omp declare reduction(welford : reduce_stats_t :                      \
+  omp_out = reduce_stats_merge(omp_out, omp_in))                               \
+  initializer(omp_priv = { 0, 0.0, 0.0 })
+
+static inline reduce_stats_t reduce_stats_d(const double* x, long n) {
+  reduce_stats_t stats = { 0, 0.0, 0.0 };
+  long c;
+
+  #pragma omp parallel for reduction(welford : stats) schedule(static)
+  for (c = 0; c < n; c += REDUCE_CHUNK) {
+    long end = (n - c < REDUCE_CHUNK) ? n : c + REDUCE_CHUNK;
+    reduce_stats_t chunk = { end - c, 0.0, 0.0 };
+    double sum = 0.0, m2 = 0.0;
+
+    #pragma omp simd reduction(+:sum)
+    for (long k = c; k < end; ++k) {
+      sum += x[k];
+    }
+    chunk.mean = sum / chunk.n;
+
+    #pragma omp simd reduction(+:m2)
+    for (long k = c; k < end; ++k) {
+      double d = x[k] - chunk.mean;
+      m2 += d * d;
+    }
+    chunk.m2 = m2;
+
+    stats = reduce_stats_merge(stats, chunk);
+  }
+
+  return stats;
+}
+
+static inline double reduce_mean_d(const double* x, long n) {
+  return reduce_stats_d(x, n).mean;
+}
+
+/**
+ * Population variance (divides by n).
+ */
+static inline double reduce_stats_variance(reduce_stats_t stats) {
+  return stats.n > 0 ? stats.m2 / stats.n : 0.0;
+}
+
+/**
+ * Sample variance (divides by n - 1).
+ */
+static inline double reduce_stats_sample_variance(reduce_stats_t stats) {
+  return stats.n > 1 ? stats.m2 / (stats.n - 1) : 0.0;
+}
+
+#endif  // REDUCE_H
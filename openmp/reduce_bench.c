@@ -0,0 +1,147 @@
+/**
+ * Benchmark of the reductions in reduce.h against plain serial loops.
+ *
+ * Runs sum, max, argmax and mean/variance over the same array of doubles,
+ * once with a straightforward scalar loop (like array_max in
+ * ../mpi/a08_e01_array_max.c) and once with reduce.h, and checks that both
+ * agree. argmax must match exactly; sum, mean and variance up to rounding.
+ *
+ * Compile and run:
+ * gcc -O2 -march=native -fopenmp -o reduce_bench reduce_bench.c -lm
+ * OMP_NUM_THREADS=8 ./reduce_bench [n] [reps]
+ */
+
+#include <assert.h>
+#include <math.h>     /* fabs */
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atol, atoi */
+
+#include "parallel_rng.h"
+#include "reduce.h"
+
+#define N    50000000L
+#define REPS 5
+#define SEED 12345
+
+// Relative tolerance for the results that depend on the summation order.
+#define TOLERANCE 1e-9
+
+// Keeps the compiler from optimizing the work away.
+volatile double sink;
+
+double serial_sum(const double* x, long n) {
+  double sum = 0.0;
+  for (long i = 0; i < n; ++i) sum += x[i];
+  return sum;
+}
+
+double serial_max(const double* x, long n) {
+  double max = -INFINITY;
+  for (long i = 0; i < n; ++i) {
+    if (x[i] > max) max = x[i];
+  }
+  return max;
+}
+
+reduce_loc_d_t serial_argmax(const double* x, long n) {
+  reduce_loc_d_t best = { -INFINITY, -1 };
+  for (long i = 0; i < n; ++i) {
+    if (x[i] > best.value) {
+      best.value = x[i];
+      best.index = i;
+    }
+  }
+  return best;
+}
+
+/**
+ * The textbook two-pass mean and variance.
+ */
+reduce_stats_t serial_stats(const double* x, long n) {
+  reduce_stats_t stats = { n, 0.0, 0.0 };
+  stats.mean = serial_sum(x, n) / n;
+  for (long i = 0; i < n; ++i) {
+    double d = x[i] - stats.mean;
+    stats.m2 += d * d;
+  }
+  return stats;
+}
+
+int close_enough(double a, double b) {
+  return fabs(a - b) <= TOLERANCE * fabs(b) + 1e-300;
+}
+
+void report(const char* name, double t_serial, double t_reduce, long n,
+            int correct) {
+  printf("%s,%.5f,%.5f,%.1f,%.2f,%s\n", name, t_serial, t_reduce,
+         n * sizeof(double) / t_reduce * 1e-9, t_serial / t_reduce,
+         correct ? "yes" : "NO");
+}
+
+/**
+ * Best of `reps` runs of EXPR, in seconds.
+ */
+#define BEST_TIME(best, reps, EXPR)                       \
+  do {                                                    \
+    best = 1e30;                                          \
+    for (int r_ = 0; r_ < (reps); ++r_) {                 \
+      double t_ = omp_get_wtime();                        \
+      EXPR;                                               \
+      t_ = omp_get_wtime() - t_;                          \
+      if (t_ < best) best = t_;                           \
+    }                                                     \
+  } while (0)
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  long n = N;
+  int reps = REPS;
+  long i;
+
+  if (argc > 1) n = atol(argv[1]);
+  if (argc > 2) reps = atoi(argv[2]);
+
+  double* x = (double*)malloc(sizeof(double) * n);
+  assert(x != NULL);
+
+  // Values around 1e6, so the variance is small compared to the mean.
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < n; ++i) {
+    x[i] = 1e6 + rng_uniform(SEED, (uint64_t)i);
+  }
+
+  printf("threads = %d, n = %ld\n", omp_get_max_threads(), n);
+  printf("reduction,serial_s,reduce_s,reduce_GB_per_s,speedup,correct\n");
+
+  double t_serial, t_reduce, a = 0.0, b = 0.0;
+
+  BEST_TIME(t_serial, reps, a = serial_sum(x, n));
+  BEST_TIME(t_reduce, reps, b = reduce_sum_d(x, n));
+  report("sum", t_serial, t_reduce, n, close_enough(b, a));
+
+  BEST_TIME(t_serial, reps, a = serial_max(x, n));
+  BEST_TIME(t_reduce, reps, b = reduce_max_d(x, n));
+  report("max", t_serial, t_reduce, n, a == b);
+
+  reduce_loc_d_t loc_serial, loc_reduce;
+  BEST_TIME(t_serial, reps, loc_serial = serial_argmax(x, n));
+  BEST_TIME(t_reduce, reps, loc_reduce = reduce_argmax_d(x, n));
+  report("argmax", t_serial, t_reduce, n,
+         loc_serial.value == loc_reduce.value
+         && loc_serial.index == loc_reduce.index);
+
+  reduce_stats_t st_serial, st_reduce;
+  BEST_TIME(t_serial, reps, st_serial = serial_stats(x, n));
+  BEST_TIME(t_reduce, reps, st_reduce = reduce_stats_d(x, n));
+  report("mean_variance", t_serial, t_reduce, n,
+         close_enough(st_reduce.mean, st_serial.mean)
+         && close_enough(reduce_stats_variance(st_reduce),
+                         reduce_stats_variance(st_serial)));
+
+  sink = a + b;
+  free(x);
+  return 0;
+}
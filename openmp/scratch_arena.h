@@ -0,0 +1,135 @@
+/**
+ * Per-thread scratch memory for hot loops, built on `threadprivate`.
+ *
+ * Calling malloc()/free() inside a parallel loop makes every thread go through
+ * the allocator, which has locks and shared state of its own. Instead, every
+ * thread reserves one block up front, and then takes scratch buffers from it
+ * by bumping a pointer. Releasing everything is just setting the pointer back
+ * to the start, so the hot path never calls malloc() or free() and never
+ * touches memory of another thread.
+ *
+ * Usage:
+ *
+ *   #pragma omp parallel
+ *   {
+ *     scratch_reserve(1 << 20);         // Once per thread; may call malloc.
+ *
+ *     #pragma omp for
+ *     for (i = 0; i < n; ++i) {
+ *       double* tmp = scratch_alloc(sizeof(double) * len[i]);
+ *       ...
+ *       scratch_reset();                // O(1).
+ *     }
+ *   }
+ *   ...
+ *   #pragma omp parallel
+ *   scratch_release();                  // Gives the blocks back.
+ *
+ * scratch_mark() / scratch_rewind() release only what was allocated after the
+ * mark, for nested scopes.
+ *
+ * The arena never grows by itself: when it is full, scratch_alloc() returns
+ * NULL, and the caller either reserves a bigger block (outside the hot loop)
+ * or falls back to malloc() for that buffer.
+ *
+ * As with any threadprivate variable, a thread's arena survives between
+ * parallel regions only if dynamic threads are disabled and the number of
+ * threads doesn't change. Each translation unit that includes this header
+ * gets its own arenas.
+ */
+
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <stddef.h>   /* size_t */
+#include <stdlib.h>   /* aligned_alloc, free */
+
+#include "padded_accumulator.h"   /* CACHE_LINE_SIZE */
+
+// Alignment of every buffer returned by scratch_alloc(). Must be a power of 2.
+#ifndef SCRATCH_ALIGN
+#define SCRATCH_ALIGN 64
+#endif
+
+// Alignment of the arena blocks: the larger of the cache line and
+// SCRATCH_ALIGN, so offsets aligned to SCRATCH_ALIGN give aligned addresses.
+#define SCRATCH_BLOCK_ALIGN                                                \
+  (SCRATCH_ALIGN > CACHE_LINE_SIZE ? SCRATCH_ALIGN : CACHE_LINE_SIZE)
+
+typedef struct {
+  char* base;
+  size_t used;
+  size_t capacity;
+} scratch_arena_t;
+
+static scratch_arena_t scratch_arena = { NULL, 0, 0 };
+#pragma omp threadprivate(scratch_arena)
+
+/**
+ * Makes sure the calling thread's arena has room for `bytes`. Only allocates
+ * if the current block is too small, in which case anything allocated from
+ * the old block is lost. Call it outside the hot loop.
+ * @return 0 on success, -1 if the allocation failed.
+ */
+static inline int scratch_reserve(size_t bytes) {
+  if (bytes <= scratch_arena.capacity) return 0;
+
+  // aligned_alloc wants a multiple of the alignment.
+  size_t capacity = (bytes + SCRATCH_BLOCK_ALIGN - 1)
+                    & ~(size_t)(SCRATCH_BLOCK_ALIGN - 1);
+  char* base = (char*)aligned_alloc(SCRATCH_BLOCK_ALIGN, capacity);
+  if (base == NULL) return -1;
+
+  free(scratch_arena.base);
+  scratch_arena.base = base;
+  scratch_arena.used = 0;
+  scratch_arena.capacity = capacity;
+  return 0;
+}
+
+/**
+ * Returns `bytes` of uninitialized memory from the calling thread's arena,
+ * aligned to SCRATCH_ALIGN, or NULL if the arena is full.
+ */
+static inline void* scratch_alloc(size_t bytes) {
+  size_t start = (scratch_arena.used + SCRATCH_ALIGN - 1)
+                 & ~(size_t)(SCRATCH_ALIGN - 1);
+
+  if (start > scratch_arena.capacity
+      || bytes > scratch_arena.capacity - start) {
+    return NULL;
+  }
+
+  scratch_arena.used = start + bytes;
+  return scratch_arena.base + start;
+}
+
+/**
+ * Frees everything allocated from the calling thread's arena.
+ */
+static inline void scratch_reset(void) {
+  scratch_arena.used = 0;
+}
+
+static inline size_t scratch_mark(void) {
+  return scratch_arena.used;
+}
+
+/**
+ * Frees everything allocated since `mark` was taken.
+ */
+static inline void scratch_rewind(size_t mark) {
+  scratch_arena.used = mark;
+}
+
+/**
+ * Returns the calling thread's block to the system.
+ */
+static inline void scratch_release(void) {
+  free(scratch_arena.base);
+  scratch_arena.base = NULL;
+  scratch_arena.used = 0;
+  scratch_arena.capacity = 0;
+}
+
+#endif  // SCRATCH_ARENA_H
@@ -0,0 +1,147 @@
+/**
+ * Scratch buffers inside `omp for`: malloc/free vs scratch_arena.h.
+ *
+ * Every iteration of the loop needs a temporary array of a few hundred bytes
+ * to a few tens of KB (the size depends on the iteration), fills it, and
+ * reduces it to one number, like a kernel that needs a work buffer per item.
+ * The buffer comes from:
+ *
+ * - malloc: malloc() at the start of the iteration, free() at the end.
+ * - arena:  scratch_alloc() from the thread's arena, scratch_reset() at the
+ *           end. The arena is reserved once per thread, before the loop.
+ *
+ * Both are run for 1, 2, 4, ... up to all hardware threads, and report
+ * millions of buffers per second. The results must match.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o scratch_arena_bench scratch_arena_bench.c
+ * ./scratch_arena_bench [iterations] [max_threads]
+ */
+
+#include <assert.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free, atol, atoi */
+
+#include "parallel_rng.h"
+#include "scratch_arena.h"
+
+#define ITERATIONS 2000000L
+#define MIN_LEN    32      // doubles
+#define MAX_LEN    4096    // doubles
+#define REPS       3
+#define SEED       12345
+
+/**
+ * Random buffer lengths in [MIN_LEN, MAX_LEN], one per iteration.
+ */
+void make_lengths(int* len, long iterations) {
+  rng_fill_ints(len, iterations, MAX_LEN - MIN_LEN + 1, SEED);
+  for (long i = 0; i < iterations; ++i) len[i] += MIN_LEN;
+}
+
+/**
+ * The work done with the buffer: fill it, then add it up. Only touches the
+ * first and every eighth element (one per cache line) so the allocation
+ * itself is a large part of the cost.
+ */
+static inline double use_buffer(double* buf, int len, long i) {
+  double sum = 0.0;
+  for (int k = 0; k < len; k += 8) buf[k] = (double)(i + k);
+  for (int k = 0; k < len; k += 8) sum += buf[k];
+  return sum;
+}
+
+double run_malloc(const int* len, long iterations, int nthreads) {
+  double total = 0.0;
+  long i;
+
+  #pragma omp parallel for num_threads(nthreads) reduction(+:total)
+  for (i = 0; i < iterations; ++i) {
+    double* buf = (double*)malloc(sizeof(double) * len[i]);
+    assert(buf != NULL);
+    total += use_buffer(buf, len[i], i);
+    free(buf);
+  }
+
+  return total;
+}
+
+double run_arena(const int* len, long iterations, int nthreads) {
+  double total = 0.0;
+  long i;
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    int ok = scratch_reserve(sizeof(double) * MAX_LEN) == 0;
+    assert(ok);
+    (void)ok;
+
+    #pragma omp for reduction(+:total)
+    for (i = 0; i < iterations; ++i) {
+      double* buf = (double*)scratch_alloc(sizeof(double) * len[i]);
+      assert(buf != NULL);
+      total += use_buffer(buf, len[i], i);
+      scratch_reset();
+    }
+  }
+
+  return total;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  long iterations = ITERATIONS;
+  int max_threads = omp_get_num_procs();
+
+  if (argc > 1) iterations = atol(argv[1]);
+  if (argc > 2) max_threads = atoi(argv[2]);
+
+  if (iterations <= 0 || max_threads <= 0) {
+    fprintf(stderr, "Usage: %s [iterations] [max_threads]\n", argv[0]);
+    return 1;
+  }
+
+  int* len = (int*)malloc(sizeof(int) * iterations);
+  assert(len != NULL);
+  make_lengths(len, iterations);
+
+  // The arenas are threadprivate: keep the same threads between regions.
+  omp_set_dynamic(0);
+
+  printf("threads,malloc_s,arena_s,malloc_Mbuf_per_s,arena_Mbuf_per_s,"
+         "speedup,correct\n");
+
+  for (int t = 1; ; t *= 2) {
+    if (t > max_threads) t = max_threads;
+
+    double best_malloc = 1e30, best_arena = 1e30;
+    double sum_malloc = 0.0, sum_arena = 0.0;
+
+    for (int r = 0; r < REPS; ++r) {
+      double start = omp_get_wtime();
+      sum_malloc = run_malloc(len, iterations, t);
+      double elapsed = omp_get_wtime() - start;
+      if (elapsed < best_malloc) best_malloc = elapsed;
+
+      start = omp_get_wtime();
+      sum_arena = run_arena(len, iterations, t);
+      elapsed = omp_get_wtime() - start;
+      if (elapsed < best_arena) best_arena = elapsed;
+    }
+
+    printf("%d,%.5f,%.5f,%.2f,%.2f,%.2f,%s\n", t, best_malloc, best_arena,
+           iterations / best_malloc * 1e-6, iterations / best_arena * 1e-6,
+           best_malloc / best_arena, sum_malloc == sum_arena ? "yes" : "NO");
+
+    if (t == max_threads) break;
+  }
+
+  #pragma omp parallel num_threads(max_threads)
+  scratch_release();
+
+  free(len);
+  return 0;
+}
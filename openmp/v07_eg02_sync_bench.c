@@ -0,0 +1,196 @@
+/**
+ * Cost of the OpenMP synchronization primitives under contention.
+ *
+ * v07_eg_atomic.c, v07_eg_critical_section.c and v07_eg_barriers.c show each
+ * construct once per thread. Here every thread increments one shared counter
+ * OPS times with each primitive, for 1, 2, 4, ... up to all hardware threads:
+ *
+ * - critical:       unnamed `omp critical`.
+ * - critical_named: two named critical sections; even threads use one and
+ *                   odd threads the other, each on its own counter.
+ * - atomic:         `omp atomic update`.
+ * - atomic_capture: `omp atomic capture` (fetch-and-add).
+ * - lock:           omp_set_lock / omp_unset_lock.
+ * - nest_lock:      omp_set_nest_lock / omp_unset_nest_lock.
+ * - reduction:      OPS / 100 `omp for reduction(+)` loops with one
+ *                   iteration per thread, so each one costs a combine and
+ *                   the implicit barrier.
+ * - barrier:        OPS / 100 `omp barrier`s per thread (no counter).
+ *
+ * ns_per_op is the time each thread needed per operation (wall time / number
+ * of operations per thread); Mops_per_s is the throughput of the whole team.
+ * Every run checks the final counter against the expected count.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o v07_eg02_sync_bench v07_eg02_sync_bench.c
+ * ./v07_eg02_sync_bench [ops] [max_threads]
+ */
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* atol, atoi */
+
+#define OPS 1000000L
+
+// Sum of the values fetched by atomic_capture, so the compiler can't turn the
+// capture into a plain update. Not part of any count.
+volatile long captured;
+
+typedef enum {
+  CRITICAL, CRITICAL_NAMED, ATOMIC, ATOMIC_CAPTURE, LOCK, NEST_LOCK, REDUCTION,
+  BARRIER, NUM_PRIMITIVES
+} primitive_t;
+
+const char* primitive_names[NUM_PRIMITIVES] = {
+  "critical", "critical_named", "atomic", "atomic_capture", "lock",
+  "nest_lock", "reduction", "barrier"
+};
+
+/**
+ * Runs one primitive with `nthreads` threads, `ops` operations per thread.
+ * @param  count Output: final value of the counter(s).
+ * @return       Elapsed time.
+ */
+double run(primitive_t p, int nthreads, long ops, long* count) {
+  // counter_b is the second counter of critical_named (odd threads); it stays
+  // 0 for the other primitives.
+  long counter = 0, counter_b = 0;
+  omp_lock_t lock;
+  omp_nest_lock_t nest_lock;
+  double elapsed;
+
+  omp_init_lock(&lock);
+  omp_init_nest_lock(&nest_lock);
+
+  elapsed = -omp_get_wtime();
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    int id = omp_get_thread_num();
+    long i, sink = 0;
+
+    switch (p) {
+      case CRITICAL:
+        for (i = 0; i < ops; ++i) {
+          #pragma omp critical
+          counter++;
+        }
+        break;
+
+      case CRITICAL_NAMED:
+        if (id % 2 == 0) {
+          for (i = 0; i < ops; ++i) {
+            #pragma omp critical (even)
+            counter++;
+          }
+        }
+        else {
+          for (i = 0; i < ops; ++i) {
+            #pragma omp critical (odd)
+            counter_b++;
+          }
+        }
+        break;
+
+      case ATOMIC:
+        for (i = 0; i < ops; ++i) {
+          #pragma omp atomic update
+          counter++;
+        }
+        break;
+
+      case ATOMIC_CAPTURE:
+        for (i = 0; i < ops; ++i) {
+          long old;
+          #pragma omp atomic capture
+          old = counter++;
+          sink += old;
+        }
+        #pragma omp atomic update
+        captured += sink;
+        break;
+
+      case LOCK:
+        for (i = 0; i < ops; ++i) {
+          omp_set_lock(&lock);
+          counter++;
+          omp_unset_lock(&lock);
+        }
+        break;
+
+      case NEST_LOCK:
+        for (i = 0; i < ops; ++i) {
+          omp_set_nest_lock(&nest_lock);
+          counter++;
+          omp_unset_nest_lock(&nest_lock);
+        }
+        break;
+
+      case REDUCTION:
+        for (i = 0; i < ops / 100; ++i) {
+          #pragma omp for schedule(static) reduction(+:counter)
+          for (int j = 0; j < nthreads; ++j) {
+            counter++;
+          }
+        }
+        break;
+
+      case BARRIER:
+        for (i = 0; i < ops / 100; ++i) {
+          #pragma omp barrier
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  elapsed += omp_get_wtime();
+
+  omp_destroy_lock(&lock);
+  omp_destroy_nest_lock(&nest_lock);
+
+  *count = counter + counter_b;
+  return elapsed;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  long ops = OPS;
+  int max_threads = omp_get_num_procs();
+
+  if (argc > 1) ops = atol(argv[1]);
+  if (argc > 2) max_threads = atoi(argv[2]);
+
+  if (ops <= 0 || max_threads <= 0) {
+    fprintf(stderr, "Usage: %s [ops] [max_threads]\n", argv[0]);
+    return 1;
+  }
+
+  omp_set_dynamic(0);
+
+  printf("primitive,threads,ops_per_thread,time_s,ns_per_op,Mops_per_s,"
+         "correct\n");
+
+  for (int p = 0; p < NUM_PRIMITIVES; ++p) {
+    for (int t = 1; ; t *= 2) {
+      if (t > max_threads) t = max_threads;
+
+      long count;
+      long ops_done = (p == REDUCTION || p == BARRIER) ? ops / 100 : ops;
+      double elapsed = run((primitive_t)p, t, ops, &count);
+      long expected = (p == BARRIER) ? 0 : ops_done * t;
+
+      printf("%s,%d,%ld,%.4f,%.1f,%.2f,%s\n", primitive_names[p], t, ops_done,
+             elapsed, elapsed * 1e9 / ops_done, ops_done * t / elapsed * 1e-6,
+             count == expected ? "yes" : "NO");
+
+      if (t == max_threads) break;
+    }
+  }
+
+  return 0;
+}
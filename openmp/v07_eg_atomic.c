@@ -29,3 +29,5 @@ int main(void) {
   printf("Done!\n");
   return 0;
 }
+
+// See v07_eg02_sync_bench.c for the cost of atomic vs critical vs locks.
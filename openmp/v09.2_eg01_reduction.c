@@ -20,3 +20,5 @@ int main(void) {
 
   return 0;
 }
+
+// See reduce.h for sum/min/max/argmax/mean/variance over whole arrays.
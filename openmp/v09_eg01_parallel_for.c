@@ -45,3 +45,5 @@ int main(void)
 //
 // Compiler decides.
 // schedule(auto)
+//
+// See v09_eg02_schedule_explorer.c for a benchmark of all of them.
@@ -0,0 +1,185 @@
+/**
+ * Benchmark of the `omp for` schedules listed at the end of
+ * v09_eg01_parallel_for.c.
+ *
+ * The loop uses schedule(runtime), so the schedule is picked with
+ * omp_set_schedule() before each run (or with the OMP_SCHEDULE environment
+ * variable, see below), and the exact same loop is measured under every
+ * schedule kind and chunk size.
+ *
+ * Iteration i costs cost[i] units of work, for four synthetic workloads:
+ * - uniform:    every iteration costs the same.
+ * - increasing: the cost grows linearly with i (like a triangular loop).
+ * - random:     uniformly random costs.
+ * - heavy_tail: Pareto-distributed costs; a few iterations are very expensive.
+ *
+ * Each thread records how long it spent in the loop (the loop has `nowait`, so
+ * a thread stops the clock as soon as it runs out of iterations). The load
+ * imbalance is (max - mean) / max of those times: 0% means every thread was
+ * busy until the end, 50% means that on average threads sat idle for half of
+ * the loop.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o v09_eg02_schedule_explorer \
+ *     v09_eg02_schedule_explorer.c -lm
+ * OMP_NUM_THREADS=8 ./v09_eg02_schedule_explorer
+ *
+ * Only the schedule in OMP_SCHEDULE:
+ * OMP_SCHEDULE="dynamic,4" ./v09_eg02_schedule_explorer env
+ */
+
+#include <assert.h>
+#include <math.h>     /* pow */
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* malloc, free */
+#include <string.h>   /* strcmp */
+
+#include "parallel_rng.h"
+
+#define N            20000
+#define MEAN_COST    2000
+#define PARETO_ALPHA 1.5
+#define MAX_COST     (100 * MEAN_COST)
+#define SEED         12345
+
+const char* workload_names[] = { "uniform", "increasing", "random",
+                                 "heavy_tail" };
+
+typedef struct {
+  omp_sched_t kind;
+  int chunk;  // 0 means the implementation's default.
+} schedule_t;
+
+const schedule_t schedules[] = {
+  { omp_sched_static, 0 },  { omp_sched_static, 1 },
+  { omp_sched_static, 16 }, { omp_sched_static, 256 },
+  { omp_sched_dynamic, 1 }, { omp_sched_dynamic, 16 },
+  { omp_sched_dynamic, 256 },
+  { omp_sched_guided, 1 },  { omp_sched_guided, 16 },
+  { omp_sched_guided, 256 },
+  { omp_sched_auto, 0 },
+};
+
+// Keeps the compiler from optimizing the work away.
+volatile double sink;
+
+const char* kind_name(omp_sched_t kind) {
+  switch (kind & ~omp_sched_monotonic) {
+    case omp_sched_static:  return "static";
+    case omp_sched_dynamic: return "dynamic";
+    case omp_sched_guided:  return "guided";
+    case omp_sched_auto:    return "auto";
+    default:                return "unknown";
+  }
+}
+
+/**
+ * Fills cost[] for the given workload. The mean cost is about MEAN_COST.
+ */
+void make_workload(int workload, int* cost, int n) {
+  for (int i = 0; i < n; ++i) {
+    double u = rng_uniform(SEED, (uint64_t)i);
+    switch (workload) {
+      case 0: cost[i] = MEAN_COST; break;
+      case 1: cost[i] = (int)(2.0 * MEAN_COST * i / n) + 1; break;
+      case 2: cost[i] = (int)(2.0 * MEAN_COST * u) + 1; break;
+      default: {
+        // Pareto with minimum xm has mean xm * alpha / (alpha - 1). u can be
+        // within 2^-53 of 1, so the draw is truncated at MAX_COST, before the
+        // cast to int; this lowers the mean by about 4%.
+        double xm = MEAN_COST * (PARETO_ALPHA - 1.0) / PARETO_ALPHA;
+        double draw = xm / pow(1.0 - u, 1.0 / PARETO_ALPHA);
+        cost[i] = (int)((draw < MAX_COST) ? draw : MAX_COST);
+      }
+    }
+  }
+}
+
+void do_work(int units) {
+  double x = 0.0;
+  for (int k = 0; k < units; ++k) {
+    x = x * 0.999999 + 1.0;
+  }
+  sink = x;
+}
+
+/**
+ * Runs the loop with the current runtime schedule.
+ * @param thread_times Output: time each thread spent in the loop.
+ * @return             Wall time of the whole loop.
+ */
+double run_loop(const int* cost, int n, double* thread_times) {
+  double elapsed = -omp_get_wtime();
+
+  #pragma omp parallel
+  {
+    double start = omp_get_wtime();
+
+    #pragma omp for schedule(runtime) nowait
+    for (int i = 0; i < n; ++i) {
+      do_work(cost[i]);
+    }
+
+    thread_times[omp_get_thread_num()] = omp_get_wtime() - start;
+  }
+
+  return elapsed + omp_get_wtime();
+}
+
+void report(int workload, omp_sched_t kind, int chunk, double elapsed,
+            const double* thread_times, int nthreads) {
+  double max = 0.0, mean = 0.0;
+  for (int t = 0; t < nthreads; ++t) {
+    mean += thread_times[t] / nthreads;
+    if (thread_times[t] > max) max = thread_times[t];
+  }
+
+  printf("%s,%s,%d,%.5f,%.1f,", workload_names[workload], kind_name(kind),
+         chunk, elapsed, max > 0.0 ? 100.0 * (max - mean) / max : 0.0);
+  for (int t = 0; t < nthreads; ++t) {
+    printf("%s%.5f", t ? ";" : "", thread_times[t]);
+  }
+  printf("\n");
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  int env_only = (argc > 1 && strcmp(argv[1], "env") == 0);
+  int nthreads = omp_get_max_threads();
+  int* cost = (int*)malloc(sizeof(int) * N);
+  double* thread_times = (double*)malloc(sizeof(double) * nthreads);
+  assert(cost != NULL && thread_times != NULL);
+
+  // Make sure we get all the threads we asked for.
+  omp_set_dynamic(0);
+
+  printf("threads = %d, iterations = %d\n", nthreads, N);
+  printf("workload,schedule,chunk,time_s,imbalance_pct,thread_times_s\n");
+
+  for (int w = 0; w < 4; ++w) {
+    make_workload(w, cost, N);
+
+    if (env_only) {
+      omp_sched_t kind;
+      int chunk;
+      omp_get_schedule(&kind, &chunk);
+      double elapsed = run_loop(cost, N, thread_times);
+      report(w, kind, chunk, elapsed, thread_times, nthreads);
+      continue;
+    }
+
+    for (size_t s = 0; s < sizeof(schedules) / sizeof(schedules[0]); ++s) {
+      omp_set_schedule(schedules[s].kind, schedules[s].chunk);
+      double elapsed = run_loop(cost, N, thread_times);
+      report(w, schedules[s].kind, schedules[s].chunk, elapsed, thread_times,
+             nthreads);
+    }
+  }
+
+  free(cost);
+  free(thread_times);
+  return 0;
+}
@@ -6,86 +6,129 @@
  * than the sequential version if the probability of collision of buckets is
  * low, which means NBUCKETS is very large. In this case, we'll have mostly
  * uncontended locks.
+ *
+ * The number of buckets, the number of samples and the range of the sample
+ * values can be given on the command line (defaults: NBUCKETS, NVALS and
+ * NBUCKETS). Samples are in [0, range) and are mapped to buckets
+ * proportionally. The histogram and its locks live on the heap, so very large
+ * bucket counts (10^8 and more) don't overflow the stack.
+ *
+ * All arrays are initialized by the same `omp for schedule(static)` partition
+ * that later works on them. On a NUMA machine, Linux places each page on the
+ * node of the thread that touches it first, so each thread's part of the
+ * arrays ends up in its own socket's memory.
+ *
+ * See histogram.h for lock-free versions (atomics, private histograms), and
+ * histogram_bench.c for how they compare.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o v11.2_eg_histogram v11.2_eg_histogram.c
+ * OMP_PROC_BIND=spread ./v11.2_eg_histogram [nbuckets] [nvals] [range]
  */
 
 #include <assert.h>
+#include <limits.h>  /* INT_MAX */
 #include <omp.h>
 #include <stdio.h>
-#include <stdlib.h>  /* malloc, rand, srand */
+#include <stdlib.h>  /* malloc, free, atol */
 #include <time.h>    /* time */
 
+#include "parallel_rng.h"
+
 #define NBUCKETS   100000
 #define NVALS      10000000
 
 // Set to 1 to print the sample value and the final histogram.
 #define DEBUG      0
 
-void generate_samples(int* samples);
+void generate_samples(int* samples, long nvals, int range);
 
 /**
  * Entry point
  */
-int main(void) {
+int main(int argc, char** argv) {
+
+  long nbuckets = NBUCKETS;
+  long nvals = NVALS;
+  long range = NBUCKETS;
 
-  omp_lock_t hist_locks[NBUCKETS];
-  int hist[NBUCKETS];
+  if (argc > 1) nbuckets = atol(argv[1]);
+  if (argc > 2) nvals = atol(argv[2]);
+  range = (argc > 3) ? atol(argv[3]) : nbuckets;
+
+  // rng_bounded() takes the range as an int.
+  if (nbuckets <= 0 || nvals <= 0 || range <= 0 || range > INT_MAX) {
+    fprintf(stderr, "Usage: %s [nbuckets] [nvals] [range]\n", argv[0]);
+    return 1;
+  }
+
+  omp_lock_t* hist_locks;
+  long* hist;
   int* samples;
-  int i, ival;
+  long i, ival;
 
-  samples = (int*)malloc(sizeof(int) * NVALS);
-  assert(samples != NULL);
+  // malloc only reserves virtual memory; the pages are placed when they are
+  // first written, which happens in parallel below.
+  hist_locks = (omp_lock_t*)malloc(sizeof(omp_lock_t) * nbuckets);
+  hist = (long*)malloc(sizeof(long) * nbuckets);
+  samples = (int*)malloc(sizeof(int) * nvals);
+  assert(hist_locks != NULL && hist != NULL && samples != NULL);
 
-  generate_samples(samples);
+  generate_samples(samples, nvals, (int)range);
 
   #pragma omp parallel
   {
     printf("[%d] Total threads: %d\n", omp_get_thread_num(),
            omp_get_num_threads());
 
-    #pragma omp for
-    for (i = 0; i < NBUCKETS; ++i) {
+    #pragma omp for schedule(static)
+    for (i = 0; i < nbuckets; ++i) {
       omp_init_lock(&hist_locks[i]);
       hist[i] = 0;
     }
   }
 
-  #pragma omp parallel for private(ival)
-  for (i = 0; i < NVALS; ++i) {
-    ival = samples[i];
+  #pragma omp parallel for schedule(static) private(ival)
+  for (i = 0; i < nvals; ++i) {
+    ival = (long)samples[i] * nbuckets / range;
     omp_set_lock(&hist_locks[ival]);
     hist[ival]++;
     omp_unset_lock(&hist_locks[ival]);
   }
 
-  #pragma omp parallel for
-  for (i = 0; i < NBUCKETS; ++i) {
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < nbuckets; ++i) {
     omp_destroy_lock(&hist_locks[i]);
   }
 
   if (DEBUG) {
     printf("Histogram:\n");
-    for (i = 0; i < NBUCKETS; ++i) {
-      printf("%d ---> %d\n", i, hist[i]);
+    for (i = 0; i < nbuckets; ++i) {
+      printf("%ld ---> %ld\n", i, hist[i]);
     }
   }
 
+  free(hist_locks);
+  free(hist);
+  free(samples);
+  return 0;
 }
 
 /**
- * Populate the array with random values between 0 and NBUCKETS.
+ * Populate the array with random values between 0 and range.
+ *
+ * rand() isn't thread-safe, so this uses the counter-based generator from
+ * parallel_rng.h, which fills the array from all threads. For a given seed,
+ * the samples are the same for any number of threads.
  */
-void generate_samples(int* samples) {
-  srand(time(NULL));
-
-  for (int i = 0; i < NVALS; ++i) {
-    samples[i] = rand() % NBUCKETS;
-  }
+void generate_samples(int* samples, long nvals, int range) {
+  rng_fill_ints(samples, nvals, range, (uint64_t)time(NULL));
 
   if (DEBUG) {
     printf("Sample values:\n");
-    for (int i = 0; i < NVALS; ++i) {
+    for (long i = 0; i < nvals; ++i) {
       printf("%d", samples[i]);
-      if (i != NVALS - 1) { printf(", "); }
+      if (i != nvals - 1) { printf(", "); }
     }
     printf("\n\n");
   }
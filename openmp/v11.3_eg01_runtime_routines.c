@@ -5,11 +5,23 @@
  * - omp_get_num_procs
  * - omp_get_thread_num
  * - omp_get_num_threads
+ *
+ * Where the threads end up is decided by OMP_PROC_BIND and OMP_PLACES; the
+ * program prints the binding and the thread-to-CPU map with omp_affinity.h.
+ * Compare, for example:
+ * ./v11.3_eg01_runtime_routines
+ * OMP_PROC_BIND=spread OMP_PLACES=cores ./v11.3_eg01_runtime_routines
+ *
+ * See affinity_bench.c for what the binding is worth.
  */
 
+#define _GNU_SOURCE   // sched_getcpu, for omp_affinity.h. Before any #include.
+
 #include <omp.h>
 #include <stdio.h>
 
+#include "omp_affinity.h"
+
 void do_lots_of_stuff(int id);
 
 /**
@@ -24,6 +36,9 @@ int main(void) {
   // Give me, please, one thread per process.
   omp_set_num_threads(omp_get_num_procs());
 
+  affinity_print_settings(stdout);
+  affinity_print_thread_map(stdout);
+
   #pragma omp parallel
   {
     int id = omp_get_thread_num();
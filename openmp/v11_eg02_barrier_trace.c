@@ -0,0 +1,117 @@
+/**
+ * v11_eg01_implicit_barriers.c with timing around every barrier.
+ *
+ * Same structure as v11_eg01_implicit_barriers.c, but the big_calc functions
+ * do an amount of work that depends on the thread or the iteration, so the
+ * threads reach the barriers at different times. The program is instrumented
+ * with omp_trace.h: each thread's work, and its time waiting at each barrier,
+ * ends up in trace.json, which can be opened in chrome://tracing or
+ * https://ui.perfetto.dev.
+ *
+ * The implicit barrier at the end of the first `omp for` can't be timed by
+ * itself, so the loop is written with `nowait` followed by TRACE_BARRIER,
+ * which is equivalent.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o v11_eg02_barrier_trace v11_eg02_barrier_trace.c
+ * OMP_NUM_THREADS=4 ./v11_eg02_barrier_trace
+ */
+
+#include <omp.h>
+#include <stdio.h>
+
+#include "omp_trace.h"
+
+#define N 64
+
+// Keeps the compiler from optimizing the work away.
+volatile double sink;
+
+void spin(long units) {
+  double x = 0.0;
+  for (long k = 0; k < units; ++k) {
+    x = x * 0.999999 + 1.0;
+  }
+  sink = x;
+}
+
+int big_calc1(int id) {
+  spin(2000000L * (id + 1));
+  return id * 10;
+}
+
+int big_calc2(int i, int* array) {
+  spin(20000L * i);
+  return i + array[0];
+}
+
+int big_calc3(int i, int* array) {
+  spin(20000L * (N - i));
+  return i + array[0];
+}
+
+int big_calc4(int id) {
+  spin(1000000L);
+  return id * 2;
+}
+
+/**
+ * Entry point.
+ */
+int main(void) {
+
+  int A[N], B[N], C[N];
+  int i;
+
+  for (i = 0; i < N; ++i) {
+    A[i] = 1;
+    B[i] = 2;
+    C[i] = 3;
+  }
+
+  trace_init(NULL);
+
+  #pragma omp parallel shared(A, B, C)
+  {
+    int id = omp_get_thread_num();
+    double t0 = trace_now();
+    double t_region = t0;
+
+    A[id % N] = big_calc1(id);
+    trace_record("big_calc1", t0);
+
+    TRACE_BARRIER("explicit barrier");
+
+    t0 = trace_now();
+    #pragma omp for nowait
+    for (int i = 0; i < N; ++i) {
+      C[i] = big_calc2(i, A);
+    }
+    trace_record("for (big_calc2)", t0);
+
+    // Stands in for the implicit barrier of the loop above.
+    TRACE_BARRIER("implicit barrier after for");
+
+    // There is NOT going to be an implicit barrier at the end of this loop.
+    t0 = trace_now();
+    #pragma omp for nowait
+    for (int i = 0; i < N; ++i) {
+      B[i] = big_calc3(i, C);
+    }
+    trace_record("for nowait (big_calc3)", t0);
+
+    t0 = trace_now();
+    A[id % N] = big_calc4(id);
+    trace_record("big_calc4", t0);
+
+    // The region ends with one more implicit barrier.
+    trace_record("parallel region", t_region);
+    TRACE_BARRIER("end of parallel region");
+  }
+
+  // The results of the nowait loop, which are complete after the region.
+  long sum = 0;
+  for (i = 0; i < N; ++i) sum += B[i];
+  printf("Done! Sum of B = %ld\n", sum);
+  return 0;
+}
@@ -1,5 +1,7 @@
 /**
  * Obs: this is NOT a working example, just a snippet!
+ * See v16_eg05_linked_list.c for a complete program, and for cheaper
+ * alternatives to one task per element.
  */
 
 List ml;
@@ -0,0 +1,174 @@
+/**
+ * Task-parallel Fibonacci with a cutoff, and a benchmark of the task runtime.
+ *
+ * v16_eg02_fib_tasks.c creates two tasks per call all the way down to n < 2,
+ * so almost all of the time goes into creating and scheduling tiny tasks.
+ * Here, once n <= cutoff, the call falls back to a plain serial function, and
+ * no more tasks are created below it. (The same effect could be had with
+ * `#pragma omp task final(n <= cutoff)` and omp_in_final(), but a separate
+ * serial function also skips the taskwait and the shared variables.)
+ *
+ * Two drivers:
+ * - single:   one thread calls fib(N) inside `omp single`, and the recursion
+ *             spawns the tasks that the whole team executes.
+ * - taskloop: like v16_eg02_fib_tasks.c, computes fib(1) ... fib(N), but the
+ *             outer loop is a `taskloop` created by a single producer, instead
+ *             of an `omp for` whose iterations create nested task trees.
+ *
+ * The benchmark sweeps cutoff x threads and reports the number of tasks
+ * created, tasks per second and speedup over the serial function.
+ *
+ * Compile and run:
+ * gcc -O2 -fopenmp -o v16_eg04_fib_cutoff v16_eg04_fib_cutoff.c
+ * ./v16_eg04_fib_cutoff [N] [max_threads]
+ */
+
+#include <assert.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>   /* atoi */
+
+#include "padded_accumulator.h"
+
+// Tasks created by each thread (padded, so counting doesn't false-share).
+padded_long_t* task_count;
+
+long fib_serial(int n) {
+  if (n < 2) {
+    return n;
+  }
+  return fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+long fib(int n, int cutoff) {
+  long x, y;
+
+  if (n < 2) {
+    return n;
+  }
+
+  if (n <= cutoff) {
+    return fib_serial(n);
+  }
+
+  task_count[omp_get_thread_num()].value += 2;
+
+  #pragma omp task shared(x)
+  x = fib(n - 1, cutoff);
+  #pragma omp task shared(y)
+  y = fib(n - 2, cutoff);
+  #pragma omp taskwait
+  return x + y;
+}
+
+/**
+ * One producer, one task tree.
+ */
+long driver_single(int n, int cutoff, int nthreads) {
+  long result = 0;
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    #pragma omp single
+    result = fib(n, cutoff);
+  }
+
+  return result;
+}
+
+/**
+ * fib(1) ... fib(n) as a taskloop. Returns the sum of all of them.
+ */
+long driver_taskloop(int n, int cutoff, int nthreads) {
+  long results[n + 1];
+  long sum = 0;
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    #pragma omp single
+    {
+      // Largest n first would be better for balance, but keep the same order
+      // as v16_eg02_fib_tasks.c.
+      #pragma omp taskloop grainsize(1)
+      for (int i = 1; i <= n; ++i) {
+        results[i] = fib(i, cutoff);
+      }
+    }
+  }
+
+  for (int i = 1; i <= n; ++i) {
+    sum += results[i];
+  }
+  return sum;
+}
+
+long total_tasks(int nthreads) {
+  long total = 0;
+  for (int t = 0; t < nthreads; ++t) {
+    total += task_count[t].value;
+    task_count[t].value = 0;
+  }
+  return total;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char** argv) {
+  int n = 32;
+  int max_threads = omp_get_num_procs();
+  const int cutoffs[] = { 1, 5, 10, 15, 20, 25 };
+  const int num_cutoffs = sizeof(cutoffs) / sizeof(cutoffs[0]);
+
+  if (argc > 1) n = atoi(argv[1]);
+  if (argc > 2) max_threads = atoi(argv[2]);
+
+  if (max_threads <= 0) {
+    fprintf(stderr, "Usage: %s [N] [max_threads]\n", argv[0]);
+    return 1;
+  }
+
+  omp_set_dynamic(0);
+
+  task_count = padded_long_alloc(max_threads);
+  assert(task_count != NULL);
+
+  // Baselines: serial fib(n), and serial fib(1) ... fib(n).
+  double t_serial = -omp_get_wtime();
+  long expected = fib_serial(n);
+  t_serial += omp_get_wtime();
+
+  double t_serial_all = -omp_get_wtime();
+  long expected_all = 0;
+  for (int i = 1; i <= n; ++i) expected_all += fib_serial(i);
+  t_serial_all += omp_get_wtime();
+
+  printf("fib(%d) = %ld, serial: %lfs (all fib(1..%d): %lfs)\n", n, expected,
+         t_serial, n, t_serial_all);
+  printf("driver,cutoff,threads,time_s,tasks,tasks_per_s,speedup,correct\n");
+
+  for (int d = 0; d < 2; ++d) {
+    for (int c = 0; c < num_cutoffs; ++c) {
+      for (int t = 1; ; t *= 2) {
+        if (t > max_threads) t = max_threads;
+
+        double elapsed = -omp_get_wtime();
+        long result = d ? driver_taskloop(n, cutoffs[c], t)
+                        : driver_single(n, cutoffs[c], t);
+        elapsed += omp_get_wtime();
+
+        long tasks = total_tasks(t);
+        double base = d ? t_serial_all : t_serial;
+
+        printf("%s,%d,%d,%.4f,%ld,%.3e,%.2f,%s\n", d ? "taskloop" : "single",
+               cutoffs[c], t, elapsed, tasks, tasks / elapsed, base / elapsed,
+               result == (d ? expected_all : expected) ? "yes" : "NO");
+
+        if (t == max_threads) break;
+      }
+    }
+  }
+
+  padded_free(task_count);
+  return 0;
+}
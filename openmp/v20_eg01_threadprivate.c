@@ -22,3 +22,5 @@ int main(void) {
     }
   }
 }
+
+// See scratch_arena.h for a threadprivate per-thread scratch allocator.